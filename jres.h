@@ -36,11 +36,40 @@
 
 namespace JRES {
 
+  //Allocator of resource buffers returned by LoadResource, for example
+  //to decode directly into caller's arena or staging memory.
+  struct IResAllocator {
+    virtual void* Alloc(size_t size) = 0;
+    //Called by FreeResource and Close with the same size as Alloc.
+    virtual void Free(void* buf, size_t size) = 0;
+  };
+
+  //Source of pack data for OpenReader, for example a pack appended to
+  //another file or application's own cache.
+  struct IResReader {
+    //Read up to size bytes at offset, return the number of bytes read,
+    //0 at the end of data or -1 on error. Called from several threads
+    //at once when resources are loaded concurrently.
+    virtual int Read(void* buf, size_t size, unsigned long long offset) = 0;
+  };
+
+  //Receives resources found by ListResources and FindResources.
+  struct IResVisitor {
+    //id is UTF-8 path valid only during the call, size is 0 for
+    //directories. Return false to stop.
+    virtual bool Visit(const char* id, unsigned long long size, bool dir) = 0;
+  };
+
   struct IRes {
     virtual void Release() = 0;
-    //path_sep value of 0 is default internal path separator
+    //Ids can use both '/' and '\\' path separators and contain "./"
+    //segments. path_sep is kept for compatibility and not used.
     virtual bool Open(const char* filename, char path_sep) = 0;
     virtual bool Open(const wchar_t* filename, wchar_t path_sep) = 0;
+    //LoadResource and FreeResource can be called from several threads at
+    //once, loads share the archive file. Solid archives are decoded one
+    //file at a time. Each load returns own resource, the same id can be
+    //loaded again before the previous one is freed.
     virtual void* LoadResource(const char* id, char** buf, size_t& bufsize) = 0;
     virtual void* LoadResource(const wchar_t* id, char** buf, size_t& bufsize) = 0;
     virtual void FreeResource(void* res) = 0;
@@ -50,6 +79,28 @@ namespace JRES {
     virtual IStream* LoadResource(const char* id) = 0;
     virtual IStream* LoadResource(const wchar_t* id) = 0;
 #endif
+    //allocator value of nullptr is default malloc and free.
+    //Loaded resources are freed by the allocator they were loaded with,
+    //it must stay valid until they are freed.
+    virtual void SetAllocator(IResAllocator* allocator) = 0;
+    //Open the pack image in memory, data is not copied and must stay valid
+    //until Close. Stored resources point into the image, they must not be
+    //modified.
+    virtual bool OpenMemory(const void* data, size_t size, char path_sep) = 0;
+    //Open the pack of size bytes starting at offset of reader data.
+    //reader must stay valid until Close.
+    virtual bool OpenReader(IResReader* reader, unsigned long long offset,
+      unsigned long long size, char path_sep) = 0;
+    //Call visitor for files and subdirectories in dir, or for all files
+    //and stored directories below dir if recursive. dir value of "" or
+    //nullptr is the pack root. Subdirectories are known from directory
+    //entries and paths of their files. Return the number of visited entries.
+    virtual size_t ListResources(const char* dir, bool recursive,
+      IResVisitor* visitor) = 0;
+    //Call visitor for files matching mask with '*' and '?' wildcards.
+    //mask is matched as in RAR command line, so "skin/*.png" also matches
+    //.png files in subdirectories of skin.
+    virtual size_t FindResources(const char* mask, IResVisitor* visitor) = 0;
   };
 
 };
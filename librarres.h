@@ -42,6 +42,43 @@ namespace JRES {
 
     JRES::IRes* PASCAL CreateRarRes(bool ignorecase);
 
+    //Worker threads shared by all IRes objects of the process.
+    //threads value of 0 is the number of CPU cores. It's applied when
+    //the first IRes object is opened, so call it before creating them.
+    void PASCAL SetMaxThreads(unsigned int threads);
+
+    //Dictionary windows of closed IRes objects are cached and reused
+    //by next decodes. size is the maximum total size of cached windows,
+    //0 disables the cache.
+    void PASCAL SetWindowCacheSize(size_t size);
+
+    //Free all cached dictionary windows, for example on low memory.
+    void PASCAL TrimWindowCache();
+
+    //Memory budget of all loads in the process. Loads which would exceed it
+    //wait up to timeout milliseconds for other loads and FreeResource calls
+    //to release memory, then fail with RARX_MEMORY. Output buffers allocated
+    //by the library, decoder windows and cached windows are counted, cached
+    //windows are freed first. size value of 0 is unlimited.
+    void PASCAL SetMemoryBudget(size_t size, unsigned int timeout);
+
+    //Memory currently charged to the memory budget.
+    size_t PASCAL GetCommittedMemory();
+
+    //Resources of size bytes or larger are decoded to a deleted temporary
+    //file mapped to memory instead of heap, so the system can page them out
+    //without swap. Not used if IRes has a custom allocator. Such resources
+    //are not charged to the memory budget. size value of 0 disables it.
+    void PASCAL SetMappedResourceSize(size_t size);
+
+    //Archive files are read without read ahead for lookups in any order,
+    //solid archives are read sequentially. Packed data of prefetch_size
+    //bytes or more is requested from disk at once before decoding. Packed
+    //data of drop_size bytes or more is dropped from system file cache
+    //after decoding, for large resources loaded once. 0 disables each of
+    //them. Defaults are 128 KB and 0. Not supported in Windows.
+    void PASCAL SetReadAdvice(size_t prefetch_size, size_t drop_size);
+
 #ifdef __cplusplus
   }
 #endif
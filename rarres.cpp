@@ -30,37 +30,168 @@
 #include "rar.hpp"
 #include "rarres.h"
 #include "VERSION"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 namespace RARRES {
 
+  //Process-wide memory budget of loads. Charged are output buffers allocated
+  //by the library, dictionary windows held by decoders and working memory
+  //of loads in progress. Cached windows and windows of idle decode contexts
+  //are counted too and they are freed first when a load does not fit.
+  static struct CMemoryGovernor {
+    std::mutex lock_;
+    std::condition_variable released_;
+    size_t budget_;  //0 is unlimited.
+    unsigned int timeout_;  //Milliseconds to wait for memory.
+    size_t committed_;
+    size_t idle_;  //Windows of idle decode contexts, part of committed_.
+    std::mutex owners_lock_;  //Taken before lock_, owners_ are not destroyed
+    std::vector<CRarRes*> owners_;  //while their contexts are trimmed.
+
+    CMemoryGovernor()
+      : budget_(0)
+      , timeout_(0)
+      , committed_(0)
+      , idle_(0) {
+    }
+
+    bool Fits(size_t size) {
+      return budget_ == 0 || committed_ + GetWindowPoolSize() + size <= budget_;
+    }
+
+    //Reserve memory for a load, waiting until other loads release enough.
+    //Load larger than the whole budget can still run if nothing else is
+    //committed, except windows of idle contexts and own window of its
+    //context. Returns false if memory is not available in timeout.
+    bool Acquire(size_t size, size_t own) {
+      std::unique_lock<std::mutex> lock(lock_);
+      std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_);
+      while (!Fits(size)) {
+        //Freeing windows can take a while, loads releasing memory do not
+        //wait for it. Windows of idle contexts go to the cache first.
+        bool idle = idle_ != 0;
+        lock.unlock();
+        if (idle)
+          TrimIdle();
+        TrimWindowPool();
+        lock.lock();
+        if (Fits(size) || committed_ <= idle_ + own)
+          break;
+        if (released_.wait_until(lock, deadline) == std::cv_status::timeout
+          && !Fits(size))
+          return false;
+      }
+      committed_ += size;
+      return true;
+    }
+
+    //Replace reserved memory with memory which stays allocated after load.
+    void Release(size_t reserved, size_t kept = 0) {
+      std::lock_guard<std::mutex> lock(lock_);
+      committed_ = committed_ - reserved + kept;
+      if (kept < reserved)
+        released_.notify_all();
+    }
+
+    //Decode context with window of size bytes starts or stops waiting
+    //for loads.
+    void SetIdle(size_t size, bool idle) {
+      if (size == 0)
+        return;
+      std::lock_guard<std::mutex> lock(lock_);
+      if (idle) {
+        idle_ += size;
+        released_.notify_all();
+      }
+      else
+        idle_ -= size;
+    }
+
+    void AddOwner(CRarRes* owner) {
+      std::lock_guard<std::mutex> lock(owners_lock_);
+      owners_.push_back(owner);
+    }
+
+    void RemoveOwner(CRarRes* owner) {
+      std::lock_guard<std::mutex> lock(owners_lock_);
+      owners_.erase(std::find(owners_.begin(), owners_.end(), owner));
+    }
+
+    //Free windows of idle contexts of all objects. Must be called without
+    //lock_, contexts release their memory through it.
+    void TrimIdle() {
+      std::lock_guard<std::mutex> lock(owners_lock_);
+      for (auto owner : owners_)
+        owner->TrimContexts();
+    }
+
+    size_t Committed() {
+      std::lock_guard<std::mutex> lock(lock_);
+      return committed_ + GetWindowPoolSize();
+    }
+  } governor;
+
+  //Resources of this size or larger are decoded to temporary file mappings.
+  //Exports change these settings while loads read them.
+  static std::atomic<size_t> mapped_size(0);
+
+  //Packed data of this size or larger is prefetched before decoding
+  //and dropped from system cache after it. 0 disables it.
+  static std::atomic<size_t> prefetch_size(0x20000);
+  static std::atomic<size_t> drop_size(0);
+
+  //Handle of loads to caller's buffer, FreeResource has nothing to free.
+  static RARRES_RESOURCE unowned_resource = {};
+
   CRarRes::CRarRes(bool ignorecase)
-    : unp_(nullptr)
-    , arc_(&cmd_)
+    : arc_(&cmd_)
+    , resources_(nullptr)
+    , allocator_(nullptr)
+    , reader_(nullptr)
+    , reader_offset_(0)
     , flags_(0)
     , total_packsize_(0)
     , total_unpsize_(0)
     , ignorecase_(ignorecase) {
+    governor.AddOwner(this);
   }
 
   CRarRes::~CRarRes() {
+    governor.RemoveOwner(this);
     Close();
   }
 
   void CRarRes::Close() {
-    if (unp_) {
-      delete unp_;
-      unp_ = nullptr;
+    //Loads of other objects can trim contexts at the same time.
+    std::vector<RARRES_CONTEXT*> contexts;
+    {
+      std::lock_guard<std::mutex> lock(contexts_lock_);
+      contexts.swap(contexts_);
     }
-    arc_.Close();
-    for (auto it : fileheadersW_) {
-      if (it.second->Data) {
-        free(it.second->Data);
-        it.second->Data = nullptr;
-      }
-      delete it.second;
+    for (auto ctx : contexts) {
+      governor.SetIdle(ctx->UnpMemSize, false);
+      governor.Release(ctx->UnpMemSize);
+      delete ctx;
     }
-    fileheadersW_.clear();
-    fileheadersA_.clear();
+    for (size_t i = 1; i < volumes_.size(); ++i)
+      delete volumes_[i];
+    std::vector<Archive*>().swap(volumes_);
+    std::vector<VolumeDataPart>().swap(parts_);
+    arc_.Close();
+    reader_ = nullptr;
+    reader_offset_ = 0;
+    while (resources_)
+      FreeData(resources_);
+    std::vector<RARRES_FILEHEADER>().swap(fileheaders_);
+    std::vector<uint32>().swap(sortedheaders_);
+    std::vector<RARRES_FOLDSLOT>().swap(foldindex_);
+    std::vector<char>().swap(names_);
+    std::vector<byte>().swap(digests_);
     flags_ = 0;
     total_packsize_ = 0;
     total_unpsize_ = 0;
@@ -77,12 +208,10 @@ namespace RARRES {
 #else
     UtfToWide(filename, FileName, ASIZE(FileName));
 #endif
-    wchar_t sep = 0;
-    ((char*)&sep)[0] = path_sep;
-    return Open(FileName, sep);
+    return Open(FileName, (wchar_t)path_sep);
   }
 
-  bool CRarRes::Open(const wchar_t* filename, wchar_t path_sep) {
+  bool CRarRes::Open(const wchar_t* filename, wchar_t /*path_sep*/) {
     Close();
     cmd_.Init();
     cmd_.AddArcName(filename);
@@ -90,10 +219,57 @@ namespace RARRES {
     cmd_.VersionControl = 1;
     cmd_.OpenShared = true;
 
+    //Resources are looked up in any order, read ahead is chosen after
+    //the archive type is known.
+    arc_.RemoveSequentialFlag();
     if (!arc_.Open(filename, FMF_OPENSHARED)) {
       ErrHandler.OpenErrorMsg(filename);
       return false;
     }
+    if (!OpenArchive())
+      return false;
+    if (arc_.Volume)
+      OpenVolumes();
+    if (!ListFiles())
+      return false;
+    //Files of solid archive are decoded in order.
+    for (auto vol : volumes_)
+      vol->Advise(0, 0, arc_.Solid ? FAH_SEQUENTIAL : FAH_RANDOM);
+    return true;
+  }
+
+  bool CRarRes::OpenMemory(const void* data, size_t size, char /*path_sep*/) {
+    Close();
+    cmd_.Init();
+    cmd_.Overwrite = OVERWRITE_ALL;
+    cmd_.VersionControl = 1;
+
+    arc_.OpenMemory((const byte*)data, size, L"<memory>");
+    return OpenArchive() && ListFiles();
+  }
+
+  bool CRarRes::OpenReader(JRES::IResReader* reader, unsigned long long offset,
+    unsigned long long size, char /*path_sep*/) {
+    Close();
+    cmd_.Init();
+    cmd_.Overwrite = OVERWRITE_ALL;
+    cmd_.VersionControl = 1;
+
+    reader_ = reader;
+    reader_offset_ = offset;
+    arc_.OpenReader(ReadProc, this, size, L"<reader>");
+    return OpenArchive() && ListFiles();
+  }
+
+  //Archive positions are relative to the pack start.
+  int CRarRes::ReadProc(void* param, void* data, size_t size, uint64 offset) {
+    CRarRes* res = (CRarRes*)param;
+    return res->reader_->Read(data, size, res->reader_offset_ + offset);
+  }
+
+  //Check the main header of opened archive file or image.
+  bool CRarRes::OpenArchive() {
+    const wchar_t* filename = arc_.FileName;
     if (!arc_.IsArchive(true)
       || arc_.GetHeaderType() != HEAD_MAIN) {
       arc_.Close();
@@ -119,103 +295,434 @@ namespace RARRES {
       flags_ |= 0x80;
     if (arc_.FirstVolume)
       flags_ |= 0x100;
-    return ListFiles(path_sep);
+    volumes_.push_back(&arc_);
+    return true;
+  }
+
+  struct RARRES_VOLUME {
+    Archive* Arc;
+    wchar_t Name[NM];
+    bool Opened;
+  };
+
+  static THREAD_PROC(OpenVolumeThread) {
+    RARRES_VOLUME* vol = (RARRES_VOLUME*)Data;
+    vol->Arc->RemoveSequentialFlag();
+    vol->Opened = vol->Arc->Open(vol->Name, FMF_OPENSHARED)
+      && vol->Arc->IsArchive(true) && vol->Arc->GetHeaderType() == HEAD_MAIN;
+  }
+
+  //Open all next volumes of the set at once and keep them open, so split
+  //files are read without closing and opening volumes during decode.
+  //The set ends before the first missing or broken volume.
+  void CRarRes::OpenVolumes() {
+    std::vector<RARRES_VOLUME> vols;
+    RARRES_VOLUME vol;
+    wcsncpyz(vol.Name, arc_.FileName, ASIZE(vol.Name));
+    while (true) {
+      NextVolumeName(vol.Name, ASIZE(vol.Name), !arc_.NewNumbering);
+      if (!FileExist(vol.Name))
+        break;
+      vol.Arc = new Archive(&cmd_);
+      vol.Opened = false;
+      vols.push_back(vol);
+    }
+    if (vols.empty())
+      return;
+
+    ThreadPool* pool = CreateThreadPool();
+    pool->AddTasks(OpenVolumeThread, vols.data(), sizeof(vols[0]), (uint)vols.size());
+    pool->WaitDone();
+    DestroyThreadPool(pool);
+
+    size_t i = 0;
+    for (; i < vols.size() && vols[i].Opened; ++i)
+      volumes_.push_back(vols[i].Arc);
+    for (; i < vols.size(); ++i)
+      delete vols[i].Arc;
   }
 
-  bool CRarRes::CheckUnpVer()
+  bool CRarRes::CheckUnpVer(RARRES_FILEHEADER* rhd)
   {
     bool WrongVer;
     if (arc_.Format == RARFMT50) // Both SFX and RAR can unpack RAR 5.0 archives.
-      WrongVer = arc_.FileHead.UnpVer > VER_UNPACK5;
+      WrongVer = rhd->UnpVer > VER_UNPACK5;
     else
     {
       // All formats since 1.3 for RAR.
-      WrongVer = arc_.FileHead.UnpVer<13 || arc_.FileHead.UnpVer>VER_UNPACK;
+      WrongVer = rhd->UnpVer<13 || rhd->UnpVer>VER_UNPACK;
     }
 
     // We can unpack stored files regardless of compression version field.
-    if (arc_.FileHead.Method == 0)
+    if (rhd->Method == 0)
       WrongVer = false;
 
     if (WrongVer)
     {
-      ErrHandler.UnknownMethodMsg(arc_.FileName, arc_.FileHead.FileName);
+      wchar_t NameW[NM];
+      UtfToWide(names_.data() + rhd->NameOffset, NameW, ASIZE(NameW));
+      ErrHandler.UnknownMethodMsg(arc_.FileName, NameW);
       uiMsg(UIERROR_NEWERRAR, arc_.FileName);
     }
     return !WrongVer;
   }
 
-  bool CRarRes::ListFiles(wchar_t path_sep) {
+  bool CRarRes::ListFiles() {
     if (!arc_.IsOpened())
       return false;
 
     uint FileCount = 0;
-    wchar_t VolNumText[50];
-    *VolNumText = 0;
-    while (arc_.ReadHeader() > 0)
+    //File waiting for the next part in the next volume.
+    size_t split = fileheaders_.max_size();
+    for (uint32 volume = 0; volume < (uint32)volumes_.size(); ++volume)
     {
-      HEADER_TYPE HeaderType = arc_.GetHeaderType();
-      switch (HeaderType) {
-      case HEAD_FILE:
-        ListFileHeader(arc_.FileHead, path_sep);
-        if (!arc_.FileHead.SplitBefore)
-        {
-          total_unpsize_ += arc_.FileHead.UnpSize;
-          FileCount++;
+      Archive& arc = *volumes_[volume];
+      //Headers are parsed from large reads instead of reading each
+      //header and seeking over file data.
+      arc.SetHeaderScan(true);
+      while (arc.ReadHeader() > 0)
+      {
+        HEADER_TYPE HeaderType = arc.GetHeaderType();
+        switch (HeaderType) {
+        case HEAD_FILE:
+          if (arc.FileHead.SplitBefore)
+            ListFilePart(arc, arc.FileHead, split);
+          else
+          {
+            //Next part of previous file is missing.
+            if (split < fileheaders_.size())
+              fileheaders_[split].Part = RARRES_NOPART;
+            ListFileHeader(arc, arc.FileHead, volume);
+            total_unpsize_ += arc.FileHead.UnpSize;
+            FileCount++;
+          }
+          if (!arc.FileHead.SplitAfter || arc.FileHead.Dir)
+            split = fileheaders_.max_size();
+          else
+            if (!arc.FileHead.SplitBefore)
+              split = fileheaders_.size() - 1;
+          total_packsize_ += arc.FileHead.PackSize;
+          break;
+        default:
+          //Service headers like archive comment are not resources and
+          //must not hide packed files of the same name.
+          break;
         }
-        total_packsize_ += arc_.FileHead.PackSize;
-        break;
-      case HEAD_SERVICE:
-        ListFileHeader(arc_.SubHead, path_sep);
-        break;
+        arc.SeekToNext();
       }
-      arc_.SeekToNext();
+      arc.SetHeaderScan(false);
     }
+    if (split < fileheaders_.size())
+      fileheaders_[split].Part = RARRES_NOPART;
+    SortFileHeaders();
     return (bool)(FileCount > 0);
   }
 
-  void CRarRes::ListFileHeader(FileHeader &hd, wchar_t path_sep) {
-    if (!hd.Dir) {
-      RARRES_FILEHEADER* rhd = new RARRES_FILEHEADER;
-      *((BlockHeader*)rhd) = hd;
-      rhd->Pos = arc_.CurBlockPos;
-      rhd->PackSize = hd.PackSize < 0 ? 0 : hd.PackSize;
-      rhd->UnpSize = hd.UnpSize < 0 ? 0 : hd.UnpSize;
-      rhd->FileName = hd.FileName;
+  //Add the next part of split file, so it is decoded from volumes opened
+  //in advance. The file is not decoded if some of its parts are missing.
+  void CRarRes::ListFilePart(Archive& arc, FileHeader &hd, size_t split) {
+    if (split >= fileheaders_.size())
+      return;
+    RARRES_FILEHEADER& rhd = fileheaders_[split];
+    VolumeDataPart part;
+    part.SrcFile = &arc;
+    part.Pos = arc.NextBlockPos - hd.PackSize;
+    part.PackSize = hd.PackSize < 0 ? 0 : hd.PackSize;
+    part.SplitAfter = hd.SplitAfter;
+    if (rhd.Part == RARRES_NOPART)
+      rhd.Part = (uint32)parts_.size();
+    parts_.push_back(part);
+    //Unpacked data hash is stored in the last part.
+    if (!hd.SplitAfter && hd.FileHash.Type == rhd.HashType) {
+      if (hd.FileHash.Type == HASH_BLAKE2)
+        memcpy(&digests_[rhd.Hash * BLAKE2_DIGEST_SIZE], hd.FileHash.Digest,
+          BLAKE2_DIGEST_SIZE);
+      else
+        rhd.Hash = hd.FileHash.CRC32;
+    }
+  }
+
+  //Names are stored as is, lookups accept both path separators.
+  //Directories are stored too, so empty ones are listed.
+  void CRarRes::ListFileHeader(Archive& arc, FileHeader &hd, uint32 volume) {
+    RARRES_FILEHEADER rhd;
+    rhd.Pos = arc.CurBlockPos;
+    rhd.PackSize = hd.PackSize < 0 ? 0 : hd.PackSize;
+    rhd.UnpSize = hd.UnpSize < 0 ? 0 : hd.UnpSize;
 #ifdef _WIN32
-      rhd->Mtime = hd.mtime.GetWin();
-      rhd->Ctime = hd.ctime.GetWin();
+    rhd.Mtime = hd.mtime.GetWin();
+    rhd.Ctime = hd.ctime.GetWin();
 #else
-      rhd->Mtime = hd.mtime.GetUnixNS();
-      rhd->Ctime = hd.ctime.GetUnixNS();
+    rhd.Mtime = hd.mtime.GetUnixNS();
+    rhd.Ctime = hd.ctime.GetUnixNS();
 #endif
-      rhd->FileAttr = hd.FileAttr;
-      rhd->Data = nullptr;
-      //Path sep default value is L'\\'
-      if ((path_sep && path_sep != L'\\')) {
-        wchar_t* ch = (wchar_t*)hd.FileName;
-        while (*ch) {
-          if (L'\\' == *ch) *ch = path_sep;
-          ++ch;
-        }
+    rhd.HeadSize = (uint32)(arc.NextBlockPos - hd.PackSize - arc.CurBlockPos);
+    rhd.Volume = volume;
+    rhd.Part = RARRES_NOPART;
+    rhd.UnpVer = (ushort)Min(hd.UnpVer, 0xffffU);
+    rhd.WinLog = 0;
+    while (((size_t)1 << rhd.WinLog) < hd.WinSize)
+      rhd.WinLog++;
+    rhd.Solid = hd.Solid;
+    rhd.SplitAfter = hd.SplitAfter;
+    rhd.Dir = hd.Dir;
+    rhd.FileAttr = hd.FileAttr;
+    rhd.HashType = (byte)hd.FileHash.Type;
+    rhd.Method = hd.Method;
+    if (hd.FileHash.Type == HASH_BLAKE2) {
+      rhd.Hash = (uint32)(digests_.size() / BLAKE2_DIGEST_SIZE);
+      digests_.insert(digests_.end(), hd.FileHash.Digest,
+        hd.FileHash.Digest + BLAKE2_DIGEST_SIZE);
+    }
+    else
+      rhd.Hash = hd.FileHash.CRC32;
+    char NameU[NM * 4];
+    WideToUtf(hd.FileName, NameU, ASIZE(NameU));
+    rhd.NameOffset = (uint32)names_.size();
+    names_.insert(names_.end(), NameU, NameU + strlen(NameU) + 1);
+    fileheaders_.push_back(rhd);
+  }
+
+  //Next character of UTF-8 or wide string. Malformed UTF-8 bytes are
+  //returned as is, so such names still match byte by byte.
+  static inline uint NextChar(const char*& s) {
+    uint c = (byte)*s;
+    if (c < 0x80) {
+      if (c)
+        s++;
+      return c;
+    }
+    const byte* b = (const byte*)s;
+    if ((c >> 5) == 6 && (b[1] & 0xc0) == 0x80) {
+      s += 2;
+      return ((c & 0x1f) << 6) | (b[1] & 0x3f);
+    }
+    if ((c >> 4) == 14 && (b[1] & 0xc0) == 0x80 && (b[2] & 0xc0) == 0x80) {
+      s += 3;
+      return ((c & 0xf) << 12) | ((b[1] & 0x3f) << 6) | (b[2] & 0x3f);
+    }
+    if ((c >> 3) == 30 && (b[1] & 0xc0) == 0x80 && (b[2] & 0xc0) == 0x80
+      && (b[3] & 0xc0) == 0x80) {
+      s += 4;
+      return ((c & 7) << 18) | ((b[1] & 0x3f) << 12) | ((b[2] & 0x3f) << 6)
+        | (b[3] & 0x3f);
+    }
+    s++;
+    return c;
+  }
+
+  static inline uint NextChar(const wchar_t*& s) {
+    uint c = (uint)*s;
+    if (!c)
+      return 0;
+    s++;
+    if (sizeof(wchar_t) == 2 && c >= 0xd800 && c <= 0xdbff
+      && (uint)*s >= 0xdc00 && (uint)*s <= 0xdfff)
+      c = ((c - 0xd800) << 10) + ((uint)*s++ - 0xdc00) + 0x10000;
+    return c;
+  }
+
+  //Next character of path as it is seen by lookups. Both '\\' and '/'
+  //are returned as '/' and "./" segments are skipped, so ids need not be
+  //normalized by callers. segment must be true at the start of path.
+  template <class T> static inline uint NextPathChar(const T*& s, bool& segment) {
+    if (segment)
+      while (s[0] == '.' && (s[1] == '/' || s[1] == '\\'))
+        s += 2;
+    uint c = NextChar(s);
+    segment = c == '/' || c == '\\';
+    return segment ? '/' : c;
+  }
+
+  //Compare paths in code point order, which is also the byte order
+  //of their UTF-8 names. With prefix all names starting with key are
+  //equal to it, they are stored together in the sorted index.
+  template <class T> static int PathCompare(const char* name, const T* key,
+    bool fold, bool prefix) {
+    bool nameseg = true, keyseg = true;
+    while (true) {
+      uint a = NextPathChar(name, nameseg), b = NextPathChar(key, keyseg);
+      if (prefix && !b)
+        return 0;
+      if (a != b && fold) {
+        a = FoldCase(a);
+        b = FoldCase(b);
       }
-      if (ignorecase_) {
-        wchar_t* ch = (wchar_t*)hd.FileName;
-        while (*ch) {
-          if ((*ch) >= L'A' && (*ch) <= L'Z')
-            *ch = (*ch) + 32;
-          ++ch;
-        }
+      if (a != b)
+        return a < b ? -1 : 1;
+      if (!a)
+        return 0;
+    }
+  }
+
+  //Path converted for CmpName, with '/' separators and case folded
+  //if fold is set.
+  template <class T> static void PathToWide(const T* s, wchar* dest,
+    size_t size, bool fold) {
+    bool segment = true;
+    size_t pos = 0;
+    while (uint c = NextPathChar(s, segment)) {
+      if (fold)
+        c = FoldCase(c);
+      if (sizeof(wchar) == 2 && c > 0xffff) {
+        if (pos + 3 > size)
+          break;
+        dest[pos++] = (wchar)(0xd800 + ((c - 0x10000) >> 10));
+        dest[pos++] = (wchar)(0xdc00 + (c & 0x3ff));
+      }
+      else {
+        if (pos + 2 > size)
+          break;
+        dest[pos++] = (wchar)c;
       }
-      fileheadersW_[hd.FileName] = rhd;
-      char NameA[NM];
+    }
+    dest[pos] = 0;
+  }
+
+  //FNV-1a hash of case folded characters.
+  template <class T> static uint32 FoldHash(const T* s) {
+    uint32 hash = 0x811c9dc5;
+    bool segment = true;
+    while (uint c = NextPathChar(s, segment))
+      hash = (hash ^ FoldCase(c)) * 0x01000193;
+    return hash;
+  }
+
+  template <class T> static bool FoldEqual(const char* name, const T* key) {
+    bool nameseg = true, keyseg = true;
+    while (true) {
+      uint a = NextPathChar(name, nameseg), b = NextPathChar(key, keyseg);
+      if (a != b && FoldCase(a) != FoldCase(b))
+        return false;
+      if (!a)
+        return true;
+    }
+  }
+
+  void CRarRes::SortFileHeaders() {
+    fileheaders_.shrink_to_fit();
+    names_.shrink_to_fit();
+    digests_.shrink_to_fit();
+
+    //Files are also sorted in ignorecase mode, the index is used to
+    //list directories and find files by mask.
+    bool fold = ignorecase_;
+    sortedheaders_.resize(fileheaders_.size());
+    for (size_t i = 0; i < sortedheaders_.size(); ++i)
+      sortedheaders_[i] = (uint32)i;
+    const char* names = names_.data();
+    const RARRES_FILEHEADER* rhd = fileheaders_.data();
+    std::sort(sortedheaders_.begin(), sortedheaders_.end(),
+      [names, rhd, fold](uint32 a, uint32 b) {
+        int diff = PathCompare(names + rhd[a].NameOffset,
+          names + rhd[b].NameOffset, fold, false);
+        return diff < 0 || (diff == 0 && a < b);
+      });
+
+    //Same name can be stored more than once, for example when files are
+    //added to archive with the append option. The last one wins.
+    size_t count = 0;
+    for (size_t i = 0; i < sortedheaders_.size(); ++i) {
+      if (i + 1 < sortedheaders_.size()
+        && PathCompare(names + rhd[sortedheaders_[i]].NameOffset,
+          names + rhd[sortedheaders_[i + 1]].NameOffset, fold, false) == 0)
+        continue;
+      sortedheaders_[count++] = sortedheaders_[i];
+    }
+    sortedheaders_.resize(count);
+    sortedheaders_.shrink_to_fit();
+    if (ignorecase_)
+      HashFileHeaders();
+  }
+
+  //Case insensitive index is a hash table of case folded names. Ids are
+  //found in any case without making their lowercase copies.
+  void CRarRes::HashFileHeaders() {
+    size_t size = 16;
+    while (size < fileheaders_.size() * 2)
+      size *= 2;
+    foldindex_.assign(size, RARRES_FOLDSLOT());
+    const char* names = names_.data();
+    for (uint32 i = 0; i < (uint32)fileheaders_.size(); ++i) {
+      const char* name = names + fileheaders_[i].NameOffset;
+      uint32 hash = FoldHash(name);
+      size_t pos = hash & (size - 1);
+      //Same name can be stored more than once, the last one wins.
+      while (foldindex_[pos].Record != 0 && (foldindex_[pos].Hash != hash
+        || !FoldEqual(names + fileheaders_[foldindex_[pos].Record - 1].NameOffset, name)))
+        pos = (pos + 1) & (size - 1);
+      foldindex_[pos].Hash = hash;
+      foldindex_[pos].Record = i + 1;
+    }
+  }
+
+  template <class T>
+  RARRES_FILEHEADER* CRarRes::FindFoldedHeader(const T* name) {
+    if (foldindex_.empty())
+      return nullptr;
+    uint32 hash = FoldHash(name);
+    size_t mask = foldindex_.size() - 1;
+    for (size_t pos = hash & mask; foldindex_[pos].Record != 0; pos = (pos + 1) & mask) {
+      RARRES_FILEHEADER* rhd = &fileheaders_[foldindex_[pos].Record - 1];
+      if (foldindex_[pos].Hash == hash && FoldEqual(names_.data() + rhd->NameOffset, name))
+        return rhd;
+    }
+    return nullptr;
+  }
+
+  template <class T>
+  RARRES_FILEHEADER* CRarRes::FindSortedHeader(const T* name) {
+    const char* names = names_.data();
+    RARRES_FILEHEADER* rhd = fileheaders_.data();
+    std::vector<uint32>::iterator it = std::lower_bound(
+      sortedheaders_.begin(), sortedheaders_.end(), name,
+      [names, rhd](uint32 a, const T* key) {
+        return PathCompare(names + rhd[a].NameOffset, key, false, false) < 0;
+      });
+    if (it == sortedheaders_.end()
+      || PathCompare(names + rhd[*it].NameOffset, name, false, false) != 0)
+      return nullptr;
+    return rhd + *it;
+  }
+
+  //Sorted index records of all files with names starting with prefix.
+  template <class T>
+  std::pair<uint32*, uint32*> CRarRes::FindPrefix(const T* prefix) {
+    const char* names = names_.data();
+    const RARRES_FILEHEADER* rhd = fileheaders_.data();
+    bool fold = ignorecase_;
+    uint32* first = sortedheaders_.data();
+    uint32* last = first + sortedheaders_.size();
+    first = std::partition_point(first, last, [=](uint32 a) {
+      return PathCompare(names + rhd[a].NameOffset, prefix, fold, true) < 0;
+    });
+    last = std::partition_point(first, last, [=](uint32 a) {
+      return PathCompare(names + rhd[a].NameOffset, prefix, fold, true) == 0;
+    });
+    return std::make_pair(first, last);
+  }
+
+  //File or directory record of name.
+  template <class T>
+  RARRES_FILEHEADER* CRarRes::FindHeader(const T* name) {
+    return ignorecase_ ? FindFoldedHeader(name) : FindSortedHeader(name);
+  }
+
+  //Record of file to load, directories are not returned.
+  RARRES_FILEHEADER* CRarRes::FindFileHeader(const char* name) {
 #ifdef NO_USE_UTF8
-      WideToChar(hd.FileName, NameA, ASIZE(NameA));
+    wchar_t NameW[NM];
+    CharToWide(name, NameW, ASIZE(NameW));
+    return FindFileHeader(NameW);
 #else
-      WideToUtf(hd.FileName, NameA, ASIZE(NameA));
+    RARRES_FILEHEADER* rhd = FindHeader(name);
+    return rhd && !rhd->Dir ? rhd : nullptr;
 #endif
-      fileheadersA_[NameA] = rhd;
-    }
+  }
+
+  RARRES_FILEHEADER* CRarRes::FindFileHeader(const wchar_t* name) {
+    RARRES_FILEHEADER* rhd = FindHeader(name);
+    return rhd && !rhd->Dir ? rhd : nullptr;
   }
 
   void* CRarRes::LoadResource(const char* id, char** buf, size_t& bufsize) {
@@ -224,13 +731,7 @@ namespace RARRES {
       return nullptr;
     }
 
-    std::map<std::string, RARRES_FILEHEADER* >::iterator it = fileheadersA_.find(id);
-    if (it == fileheadersA_.end()) {
-      ErrHandler.SetErrorCode(RARX_NOFILES);
-      return nullptr;
-    }
-
-    RARRES_FILEHEADER* rhd = it->second;
+    RARRES_FILEHEADER* rhd = FindFileHeader(id);
     if (NULL == rhd) {
       ErrHandler.SetErrorCode(RARX_NOFILES);
       return nullptr;
@@ -239,79 +740,256 @@ namespace RARRES {
     return Extract(rhd, buf, bufsize);
   }
 
+  //Dictionary window needed for the file, Unpack::Init allocates at least
+  //0x40000 bytes.
+  static size_t WindowSize(RARRES_FILEHEADER* rhd) {
+    return Max((size_t)1 << rhd->WinLog, (size_t)0x40000);
+  }
+
+  //Memory a load of the file needs in addition to what the context
+  //already holds, estimated from file header.
+  size_t CRarRes::EstimateLoadSize(RARRES_FILEHEADER* rhd, RARRES_CONTEXT* ctx,
+    bool alloc_buf) {
+    size_t size = alloc_buf ? (size_t)rhd->UnpSize : 0;
+    if (rhd->Method == 0)
+      return size;
+    size_t winsize = WindowSize(rhd);
+    size_t ctxwinsize = ctx->Unp ? ctx->Unp->MaxWinSize : 0;
+    if (winsize > ctxwinsize)
+      size += winsize - ctxwinsize;
+    //Multithreaded RAR5 decoding reads up to 4 MB of packed data at once.
+    if (arc_.Format == RARFMT50 && GetPoolThreads() > 1)
+      size += (size_t)Min(rhd->PackSize, (int64)0x400000);
+    return size;
+  }
+
+  RARRES_CONTEXT* CRarRes::AcquireContext() {
+    {
+      std::lock_guard<std::mutex> lock(contexts_lock_);
+      if (!contexts_.empty()) {
+        RARRES_CONTEXT* ctx = contexts_.back();
+        contexts_.pop_back();
+        governor.SetIdle(ctx->UnpMemSize, false);
+        return ctx;
+      }
+    }
+    RARRES_CONTEXT* ctx = new RARRES_CONTEXT;
+    ctx->Dio.SetFiles(&arc_, NULL);
+    ctx->Dio.EnableShowProgress(false);
+    return ctx;
+  }
+
+  void CRarRes::ReleaseContext(RARRES_CONTEXT* ctx) {
+    governor.SetIdle(ctx->UnpMemSize, true);
+    std::lock_guard<std::mutex> lock(contexts_lock_);
+    contexts_.push_back(ctx);
+  }
+
+  //Free decoders of idle contexts when a load does not fit to memory
+  //budget. Their windows go to the window cache, which is trimmed next.
+  void CRarRes::TrimContexts() {
+    std::lock_guard<std::mutex> lock(contexts_lock_);
+    for (auto ctx : contexts_) {
+      if (!ctx->Unp)
+        continue;
+      delete ctx->Unp;
+      ctx->Unp = nullptr;
+      governor.SetIdle(ctx->UnpMemSize, false);
+      governor.Release(ctx->UnpMemSize);
+      ctx->UnpMemSize = 0;
+    }
+  }
+
   void* CRarRes::Extract(RARRES_FILEHEADER* rhd, char** buf, size_t& bufsize) {
     if (!buf || ((*buf) && rhd->UnpSize > (int64)bufsize)) {
       bufsize = (size_t)rhd->UnpSize;
       ErrHandler.SetErrorCode(RARX_SUCCESS);
       return nullptr;
     }
+    if (!CheckUnpVer(rhd)) {
+      ErrHandler.SetErrorCode(RARX_FATAL);
+      return nullptr;
+    }
+    if (rhd->SplitAfter && rhd->Part == RARRES_NOPART) {
+      ErrHandler.SetErrorCode(RARX_OPEN);
+      return nullptr;
+    }
 
-    dio_.UnpArcSize = arc_.FileLength();
-    dio_.UnpVolume = false;
-    arc_.Seek(rhd->Pos, SEEK_SET);
+    //Stored file in archive image is served from the image itself.
+    //It is not owned and not charged, so its handle is not owned too.
+    const byte* image = arc_.GetMemory();
+    int64 datapos = rhd->Pos + rhd->HeadSize;
+    if (image && rhd->Method == 0 && !rhd->SplitAfter
+      && rhd->PackSize >= rhd->UnpSize
+      && datapos + rhd->UnpSize <= (int64)arc_.GetMemorySize()) {
+      bufsize = (size_t)rhd->UnpSize;
+      if (*buf)
+        memcpy(*buf, image + datapos, bufsize);
+      else
+        *buf = (char*)(image + datapos);
+      return &unowned_resource;
+    }
 
-    void* result = nullptr;
-    if (arc_.ReadHeader() > 0) {
-      if (!CheckUnpVer()) {
-        ErrHandler.SetErrorCode(RARX_FATAL);
-        return nullptr;
-      }
+    //Files of solid archive depend on previously decoded files, so they
+    //are decoded one at a time with the same context.
+    std::unique_lock<std::mutex> solid_lock(solid_lock_, std::defer_lock);
+    if (arc_.Solid)
+      solid_lock.lock();
+    RARRES_CONTEXT* ctx = AcquireContext();
+    void* result = Extract(rhd, ctx, buf, bufsize);
+    ReleaseContext(ctx);
+    return result;
+  }
 
-      if (!unp_) {
-        unp_ = new Unpack(&dio_);
-        if (!unp_) {
+  //Replace memory reserved by a load with the output buffer of kept bytes
+  //and the decoder window, which stays with the context until Close.
+  static void ReleaseLoad(RARRES_CONTEXT* ctx, size_t loadsize, size_t kept) {
+    size_t memsize = ctx->Unp ? ctx->Unp->MaxWinSize : 0;
+    governor.Release(loadsize + ctx->UnpMemSize, kept + memsize);
+    ctx->UnpMemSize = memsize;
+  }
+
+  //Decode the file with context. Packed data is read with positional reads
+  //from the shared archive file, so contexts can be used at the same time.
+  void* CRarRes::Extract(RARRES_FILEHEADER* rhd, RARRES_CONTEXT* ctx,
+    char** buf, size_t& bufsize) {
+    //Huge resources go to a file mapping, so they can be paged out
+    //without swap. Custom allocator is used for all sizes.
+    size_t mapsize = mapped_size;
+    bool mapped = !(*buf) && !allocator_ && mapsize
+      && rhd->UnpSize >= (int64)mapsize;
+    size_t loadsize = EstimateLoadSize(rhd, ctx, !(*buf) && !mapped);
+    if (!governor.Acquire(loadsize, ctx->UnpMemSize)) {
+      ErrHandler.SetErrorCode(RARX_MEMORY);
+      return nullptr;
+    }
+
+    uint threads = GetPoolThreads();
+    if (rhd->Method != 0) {
+      if (!ctx->Unp) {
+        ctx->Unp = new Unpack(&ctx->Dio);
+        if (!ctx->Unp) {
+          governor.Release(loadsize);
           ErrHandler.SetErrorCode(RARX_MEMORY);
           return nullptr;
         }
       }
-      uint threads = GetNumberOfThreads();
-      unp_->SetThreads(threads);
-      dio_.UnpVolume = arc_.FileHead.SplitAfter;
-      dio_.NextVolumeMissing = false;
-      arc_.Seek(arc_.NextBlockPos - arc_.FileHead.PackSize, SEEK_SET);
-
-      dio_.CurUnpRead = 0;
-      dio_.CurUnpWrite = 0;
-      dio_.UnpHash.Init(arc_.FileHead.FileHash.Type, threads);
-      dio_.PackedDataHash.Init(arc_.FileHead.FileHash.Type, threads);
-      dio_.SetPackedSizeToRead(arc_.FileHead.PackSize);
-      dio_.SetFiles(&arc_, NULL);
-      bufsize = (size_t)arc_.FileHead.UnpSize;
-      if (!(*buf)) {
-        result = malloc(bufsize);
-        *buf = (char*)result;
+      Unpack* unp = ctx->Unp;
+      size_t reserved = Max(WindowSize(rhd), unp->MaxWinSize);
+      unp->SetThreads(threads);
+      unp->Init((size_t)1 << rhd->WinLog, rhd->Solid);
+      //Cached window can be larger than the reserved one. Reserve the rest,
+      //it was counted as cached window, so it usually fits at once.
+      if (unp->MaxWinSize > reserved) {
+        size_t extra = unp->MaxWinSize - reserved;
+        if (!governor.Acquire(extra, ctx->UnpMemSize)) {
+          //Return the window to cache, where it is not charged to context.
+          //extra was not acquired, only loadsize and the window charge
+          //the context held before the load are released.
+          delete ctx->Unp;
+          ctx->Unp = nullptr;
+          ReleaseLoad(ctx, loadsize, 0);
+          ErrHandler.SetErrorCode(RARX_MEMORY);
+          return nullptr;
+        }
+        loadsize += extra;
       }
-      dio_.SetUnpackToMemory((byte*)(*buf), (uint)bufsize);
-      dio_.SetTestMode(arc_.Solid);
-      dio_.SetSkipUnpCRC(arc_.Solid);
-
-      if (arc_.FileHead.Method == 0) {
-        int64 dest_unpsize = arc_.FileHead.UnpSize;
-        Array<byte> buffer(File::CopyBufferSize());
-        while (true)
-        {
-          int readsize = dio_.UnpRead(&buffer[0], buffer.Size());
-          if (readsize <= 0)
-            break;
-          int writesize = (int64)readsize < dest_unpsize ? readsize : (int)dest_unpsize;
-          if (writesize > 0)
-          {
-            dio_.UnpWrite(&buffer[0], writesize);
-            dest_unpsize -= writesize;
-          }
-        }
+    }
+    Archive* arc = volumes_[rhd->Volume];
+    ComprDataIO& dio = ctx->Dio;
+    dio.SetFiles(arc, NULL);
+    dio.SetNextPart(rhd->SplitAfter ? &parts_[rhd->Part] : NULL);
+    dio.UnpVolume = rhd->SplitAfter;
+    dio.NextVolumeMissing = false;
+    dio.CurUnpRead = 0;
+    dio.CurUnpWrite = 0;
+    dio.UnpHash.Init((HASH_TYPE)rhd->HashType, threads);
+    dio.PackedDataHash.Init((HASH_TYPE)rhd->HashType, threads);
+    dio.SetPackedSizeToRead(rhd->PackSize);
+    int64 datapos = rhd->Pos + rhd->HeadSize;
+    dio.SetReadPos(datapos);
+    //Let the system read large packed data while decoder is starting.
+    size_t prefetch = prefetch_size;
+    if (prefetch && rhd->PackSize >= (int64)prefetch)
+      arc->Advise(datapos, rhd->PackSize, FAH_WILLNEED);
+
+    void* result = nullptr;
+    bufsize = (size_t)rhd->UnpSize;
+    if (!(*buf)) {
+      if (mapped)
+        result = MappedAlloc(bufsize);
+      if (!result && mapped) {
+        //Mapped buffer was not charged, heap one must be.
+        mapped = false;
+        if (!governor.Acquire(bufsize, ctx->UnpMemSize)) {
+          ReleaseLoad(ctx, loadsize, 0);
+          ErrHandler.SetErrorCode(RARX_MEMORY);
+          return nullptr;
+        }
+        loadsize += bufsize;
       }
-      else {
-        unp_->Init(arc_.FileHead.WinSize, arc_.FileHead.Solid);
-        unp_->SetDestSize(arc_.FileHead.UnpSize);
-        if (arc_.Format != RARFMT50 && arc_.FileHead.UnpVer <= 15)
-          unp_->DoUnpack(15, arc_.Solid);
-        else
-          unp_->DoUnpack(arc_.FileHead.UnpVer, arc_.FileHead.Solid);
+      if (!result)
+        result = allocator_ ? allocator_->Alloc(bufsize) : malloc(bufsize);
+      if (!result && bufsize) {
+        ReleaseLoad(ctx, loadsize, 0);
+        ErrHandler.SetErrorCode(RARX_MEMORY);
+        return nullptr;
+      }
+      *buf = (char*)result;
+    }
+    dio.SetUnpackToMemory((byte*)(*buf), bufsize);
+    dio.SetTestMode(arc_.Solid);
+    dio.SetSkipUnpCRC(arc_.Solid);
+
+    if (rhd->Method == 0) {
+      int64 dest_unpsize = rhd->UnpSize;
+      //Copy buffer is reused between files and sized to the file,
+      //so small stored files need no allocation.
+      Array<byte>& buffer = ctx->CopyBuf;
+      buffer.Alloc((size_t)Max(Min(rhd->PackSize, (int64)File::CopyBufferSize()), (int64)1));
+      while (true)
+      {
+        int readsize = dio.UnpRead(&buffer[0], buffer.Size());
+        if (readsize <= 0)
+          break;
+        int writesize = (int64)readsize < dest_unpsize ? readsize : (int)dest_unpsize;
+        if (writesize > 0)
+        {
+          dio.UnpWrite(&buffer[0], writesize);
+          dest_unpsize -= writesize;
+        }
       }
     }
-    rhd->Data = result;
-    return rhd;
+    else {
+      Unpack* unp = ctx->Unp;
+      unp->SetDestSize(rhd->UnpSize);
+      if (arc_.Format != RARFMT50 && rhd->UnpVer <= 15)
+        unp->DoUnpack(15, arc_.Solid);
+      else
+        unp->DoUnpack(rhd->UnpVer, rhd->Solid);
+    }
+    size_t drop = drop_size;
+    if (drop && rhd->PackSize >= (int64)drop)
+      arc->Advise(datapos, rhd->PackSize, FAH_DONTNEED);
+
+    //Output buffer stays charged until FreeResource.
+    ReleaseLoad(ctx, loadsize, result && !mapped ? bufsize : 0);
+    if (!result)
+      return &unowned_resource;
+
+    RARRES_RESOURCE* res = new RARRES_RESOURCE;
+    res->Data = result;
+    res->Size = bufsize;
+    res->Allocator = mapped ? nullptr : allocator_;
+    res->Mapped = mapped;
+    res->Owned = true;
+    res->Prev = nullptr;
+    std::lock_guard<std::mutex> lock(resources_lock_);
+    res->Next = resources_;
+    if (resources_)
+      resources_->Prev = res;
+    resources_ = res;
+    return res;
   }
 
   void* CRarRes::LoadResource(const wchar_t* id, char** buf, size_t& bufsize) {
@@ -320,13 +998,7 @@ namespace RARRES {
       return nullptr;
     }
 
-    std::map<std::wstring, RARRES_FILEHEADER* >::iterator it = fileheadersW_.find(id);
-    if (it == fileheadersW_.end()) {
-      ErrHandler.SetErrorCode(RARX_NOFILES);
-      return nullptr;
-    }
-
-    RARRES_FILEHEADER* rhd = it->second;
+    RARRES_FILEHEADER* rhd = FindFileHeader(id);
     if (NULL == rhd) {
       ErrHandler.SetErrorCode(RARX_NOFILES);
       return nullptr;
@@ -382,13 +1054,146 @@ namespace RARRES {
 #endif
 
   void CRarRes::FreeResource(void* res) {
-    if (res) {
-      RARRES_FILEHEADER* rhd = (RARRES_FILEHEADER*)res;
-      if (rhd->Data) {
-        free(rhd->Data);
-        rhd->Data = nullptr;
+    if (res && ((RARRES_RESOURCE*)res)->Owned)
+      FreeData((RARRES_RESOURCE*)res);
+  }
+
+  void CRarRes::FreeData(RARRES_RESOURCE* res) {
+    {
+      std::lock_guard<std::mutex> lock(resources_lock_);
+      if (res->Prev)
+        res->Prev->Next = res->Next;
+      else
+        resources_ = res->Next;
+      if (res->Next)
+        res->Next->Prev = res->Prev;
+    }
+    if (res->Mapped)
+      MappedFree(res->Data, res->Size);
+    else {
+      if (res->Allocator)
+        res->Allocator->Free(res->Data, res->Size);
+      else
+        free(res->Data);
+      governor.Release(res->Size);
+    }
+    delete res;
+  }
+
+  //Position in name after its directory prefix, both are read as paths.
+  //Usually name begins with the same bytes.
+  static const char* SkipPathPrefix(const char* name, const char* prefix,
+    size_t len) {
+    if (strncmp(name, prefix, len) == 0)
+      return name + len;
+    bool nameseg = true, prefixseg = true;
+    while (NextPathChar(prefix, prefixseg))
+      NextPathChar(name, nameseg);
+    return name;
+  }
+
+  //Files of dir are found in the sorted index, subdirectories are taken
+  //from directory records and paths of their files, files of subdirectory
+  //are skipped with another search. So time depends on the number of
+  //listed entries.
+  size_t CRarRes::ListResources(const char* dir, bool recursive,
+    JRES::IResVisitor* visitor) {
+    if (!arc_.IsOpened()) {
+      ErrHandler.SetErrorCode(RARX_OPEN);
+      return 0;
+    }
+
+    char prefix[NM * 4];
+    size_t len = dir ? strlen(dir) : 0;
+    if (len + 2 > ASIZE(prefix)) {
+      ErrHandler.SetErrorCode(RARX_NOFILES);
+      return 0;
+    }
+    if (len > 0)
+      memcpy(prefix, dir, len);
+    if (len > 0 && prefix[len - 1] != '/' && prefix[len - 1] != '\\')
+      prefix[len++] = '/';
+    prefix[len] = 0;
+
+    const char* names = names_.data();
+    std::pair<uint32*, uint32*> range = FindPrefix(prefix);
+    size_t count = 0;
+    for (uint32* it = range.first; it < range.second;) {
+      RARRES_FILEHEADER* rhd = &fileheaders_[*it];
+      const char* name = names + rhd->NameOffset;
+      if (!recursive) {
+        const char* sep = SkipPathPrefix(name, prefix, len);
+        while (*sep && *sep != '/' && *sep != '\\')
+          sep++;
+        if (*sep) {
+          char subdir[NM * 4];
+          size_t sublen = Min((size_t)(sep - name), ASIZE(subdir) - 2);
+          memcpy(subdir, name, sublen);
+          subdir[sublen] = 0;
+          //Directory record sorts before its files and is visited already.
+          RARRES_FILEHEADER* dirhd = FindHeader(subdir);
+          if (dirhd == nullptr || !dirhd->Dir) {
+            count++;
+            if (!visitor->Visit(subdir, 0, true))
+              break;
+          }
+          subdir[sublen] = '/';
+          subdir[sublen + 1] = 0;
+          bool fold = ignorecase_;
+          it = std::partition_point(it, range.second, [&](uint32 a) {
+            return PathCompare(names + fileheaders_[a].NameOffset, subdir,
+              fold, true) == 0;
+          });
+          continue;
+        }
       }
+      count++;
+      if (!visitor->Visit(name, rhd->Dir ? 0 : rhd->UnpSize, rhd->Dir))
+        break;
+      it++;
+    }
+    return count;
+  }
+
+  //Only files in directory of mask before its first wildcard are
+  //compared to mask.
+  size_t CRarRes::FindResources(const char* mask, JRES::IResVisitor* visitor) {
+    if (!arc_.IsOpened()) {
+      ErrHandler.SetErrorCode(RARX_OPEN);
+      return 0;
     }
+
+    //Names are converted with case folding instead of relying on
+    //CmpName, which is case sensitive in Unix.
+    wchar MaskW[NM], Prefix[NM], NameW[NM];
+    PathToWide(mask, MaskW, ASIZE(MaskW), ignorecase_);
+    size_t len = 0;
+    for (size_t i = 0; MaskW[i] != 0 && MaskW[i] != '*' && MaskW[i] != '?'; i++)
+      if (MaskW[i] == '/')
+        len = i + 1;
+    wcsncpy(Prefix, MaskW, len);
+    Prefix[len] = 0;
+
+    const char* names = names_.data();
+    std::pair<uint32*, uint32*> range = FindPrefix(Prefix);
+    size_t count = 0;
+    for (uint32* it = range.first; it < range.second; it++) {
+      RARRES_FILEHEADER* rhd = &fileheaders_[*it];
+      if (rhd->Dir)
+        continue;
+      const char* name = names + rhd->NameOffset;
+      PathToWide(name, NameW, ASIZE(NameW), ignorecase_);
+      if (!CmpName(MaskW, NameW, MATCH_WILDSUBPATH | MATCH_FORCECASESENSITIVE))
+        continue;
+      count++;
+      if (!visitor->Visit(name, rhd->UnpSize, false))
+        break;
+    }
+    return count;
+  }
+
+  void CRarRes::SetAllocator(JRES::IResAllocator* allocator) {
+    allocator_ = allocator;
   }
 
   int CRarRes::GetErrorCode() {
@@ -407,4 +1212,36 @@ namespace JRES {
     return new RARRES::CRarRes(ignorecase);
   }
 
+  void PASCAL SetMaxThreads(unsigned int threads) {
+    SetPoolThreads(threads);
+  }
+
+  void PASCAL SetWindowCacheSize(size_t size) {
+    SetWindowPoolLimit(size);
+  }
+
+  void PASCAL TrimWindowCache() {
+    TrimWindowPool();
+  }
+
+  void PASCAL SetMemoryBudget(size_t size, unsigned int timeout) {
+    std::lock_guard<std::mutex> lock(RARRES::governor.lock_);
+    RARRES::governor.budget_ = size;
+    RARRES::governor.timeout_ = timeout;
+    RARRES::governor.released_.notify_all();
+  }
+
+  size_t PASCAL GetCommittedMemory() {
+    return RARRES::governor.Committed();
+  }
+
+  void PASCAL SetMappedResourceSize(size_t size) {
+    RARRES::mapped_size = size;
+  }
+
+  void PASCAL SetReadAdvice(size_t prefetch_size, size_t drop_size) {
+    RARRES::prefetch_size = prefetch_size;
+    RARRES::drop_size = drop_size;
+  }
+
 };
@@ -31,7 +31,9 @@
 #define _RARRES_INCLUDE_
 
 #include "librarres.h"
-#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 namespace RARRES {
 
@@ -45,15 +47,61 @@ namespace RARRES {
 
 #endif  // !DISALLOW_COPY_AND_ASSIGN
   
-  struct RARRES_FILEHEADER : BlockHeader {
+  //Split file with missing next volume.
+  const uint32 RARRES_NOPART = 0xffffffff;
+
+  //Index record of one packed file. Records are kept in one contiguous
+  //array, file names are stored once in UTF-8 in the name pool.
+  struct RARRES_FILEHEADER {
     int64 Pos;
     int64 PackSize;
     int64 UnpSize;
     uint64 Mtime;
     uint64 Ctime;
     uint32 FileAttr;
+    uint32 NameOffset;  // Zero terminated name in the name pool.
+    uint32 Hash;        // CRC32 or number of BLAKE2 digest in digest pool.
+    uint32 HeadSize;    // Packed data starts at Pos + HeadSize.
+    uint32 Volume;      // Volume of the first part.
+    uint32 Part;        // Next parts of split file or RARRES_NOPART.
+    ushort UnpVer;
+    byte HashType;
+    byte Method;
+    byte WinLog;        // Dictionary size is 1 << WinLog.
+    bool Solid;
+    bool SplitAfter;
+    bool Dir;           // Directory entry, it is listed and not loaded.
+  };
+
+  //Buffer of one load, returned as resource handle. Loads of the same file
+  //at the same time get own handles, index records are not changed after
+  //Open.
+  struct RARRES_RESOURCE {
     void* Data;
-    std::wstring FileName;
+    size_t Size;
+    JRES::IResAllocator* Allocator;  // Allocator of Data, nullptr for malloc.
+    bool Mapped;        // Data is a temporary file mapping.
+    bool Owned;         // Data is freed by FreeResource.
+    RARRES_RESOURCE* Prev;  // Resources not freed yet, Close frees them.
+    RARRES_RESOURCE* Next;
+  };
+
+  //Slot of case insensitive name index.
+  struct RARRES_FOLDSLOT {
+    uint32 Hash;        // Hash of case folded name.
+    uint32 Record;      // Record number + 1 or 0 for empty slot.
+  };
+
+  //Decoder state of one load. Loads running at the same time use own
+  //contexts and read the shared archive file with positional reads.
+  struct RARRES_CONTEXT {
+    ComprDataIO Dio;
+    Unpack* Unp;        // Created by the first compressed file.
+    size_t UnpMemSize;  // Decoder memory charged to memory budget.
+    Array<byte> CopyBuf;
+
+    RARRES_CONTEXT() : Unp(nullptr), UnpMemSize(0) {}
+    ~RARRES_CONTEXT() { delete Unp; }
   };
 
   class CRarRes : public JRES::IRes {
@@ -64,10 +112,12 @@ namespace RARRES {
     Archive* GetArchive() { return &arc_; }
 
     virtual void Release();
-    //path_sep value of 0 is default internal path separator.
-    //RAR: default internal path separator is '\\'
+    //path_sep is not used, ids can contain both '/' and '\\'.
     virtual bool Open(const char* filename, char path_sep);
     virtual bool Open(const wchar* filename, wchar_t path_sep);
+    virtual bool OpenMemory(const void* data, size_t size, char path_sep);
+    virtual bool OpenReader(JRES::IResReader* reader, unsigned long long offset,
+      unsigned long long size, char path_sep);
     virtual void* LoadResource(const char* id, char** buf, size_t& bufsize);
     virtual void* LoadResource(const wchar* id, char** buf, size_t& bufsize);
     virtual void FreeResource(void* res);
@@ -77,25 +127,61 @@ namespace RARRES {
     virtual IStream* LoadResource(const char* id);
     virtual IStream* LoadResource(const wchar* id);
 #endif
+    virtual void SetAllocator(JRES::IResAllocator* allocator);
+    virtual size_t ListResources(const char* dir, bool recursive,
+      JRES::IResVisitor* visitor);
+    virtual size_t FindResources(const char* mask, JRES::IResVisitor* visitor);
 
   protected:
-    bool CheckUnpVer();
-    bool ListFiles(wchar_t path_sep);
-    void ListFileHeader(FileHeader &hd, wchar_t path_sep);
+    bool OpenArchive();
+    void OpenVolumes();
+    static int ReadProc(void* param, void* data, size_t size, uint64 offset);
+    bool CheckUnpVer(RARRES_FILEHEADER* rhd);
+    bool ListFiles();
+    void ListFileHeader(Archive& arc, FileHeader &hd, uint32 volume);
+    void ListFilePart(Archive& arc, FileHeader &hd, size_t split);
+    void SortFileHeaders();
+    void HashFileHeaders();
+    template <class T> RARRES_FILEHEADER* FindFoldedHeader(const T* name);
+    template <class T> RARRES_FILEHEADER* FindSortedHeader(const T* name);
+    template <class T> std::pair<uint32*, uint32*> FindPrefix(const T* prefix);
+    template <class T> RARRES_FILEHEADER* FindHeader(const T* name);
+    RARRES_FILEHEADER* FindFileHeader(const char* name);
+    RARRES_FILEHEADER* FindFileHeader(const wchar_t* name);
+    size_t EstimateLoadSize(RARRES_FILEHEADER* rhd, RARRES_CONTEXT* ctx,
+      bool alloc_buf);
+    RARRES_CONTEXT* AcquireContext();
+    void ReleaseContext(RARRES_CONTEXT* ctx);
+    void TrimContexts();
     void* Extract(RARRES_FILEHEADER* rhd, char** buf, size_t& bufsize);
+    void* Extract(RARRES_FILEHEADER* rhd, RARRES_CONTEXT* ctx,
+      char** buf, size_t& bufsize);
+    void FreeData(RARRES_RESOURCE* res);
 
     CommandData cmd_;
     Archive arc_;
-    ComprDataIO dio_;
-    Unpack* unp_;
-    std::map<std::string, RARRES_FILEHEADER* > fileheadersA_;
-    std::map<std::wstring, RARRES_FILEHEADER* > fileheadersW_;
+    std::vector<Archive*> volumes_;  // All volumes, the first is arc_.
+    std::vector<VolumeDataPart> parts_;  // Split file parts after the first.
+    std::vector<RARRES_CONTEXT*> contexts_;  // Idle decode contexts.
+    std::mutex contexts_lock_;
+    std::mutex solid_lock_;
+    std::vector<RARRES_FILEHEADER> fileheaders_;
+    std::vector<uint32> sortedheaders_;  // Record numbers sorted by name.
+    std::vector<RARRES_FOLDSLOT> foldindex_;  // Lookups with ignorecase.
+    std::vector<char> names_;
+    std::vector<byte> digests_;
+    RARRES_RESOURCE* resources_;  // Loaded resources not freed yet.
+    std::mutex resources_lock_;
+    JRES::IResAllocator* allocator_;
+    JRES::IResReader* reader_;
+    uint64 reader_offset_;  // Pack start in reader data.
 
   private:
     unsigned int  flags_;
     int64 total_packsize_, total_unpsize_;
     bool ignorecase_;
 
+    friend struct CMemoryGovernor;  // Frees windows of idle contexts.
     DISALLOW_COPY_AND_ASSIGN(CRarRes);
   };
 };
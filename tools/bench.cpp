@@ -0,0 +1,154 @@
+// bench.cpp: benchmarks of librarres and UnRAR internals.
+//
+// Not a part of rarres.sln. Link it with a static librarres.lib, which
+// contains UnRAR internals used here, for example:
+//   cl /O2 /EHsc /DRARDLL /DUNRAR /DSILENT /DRAR_SMP /I.. /I..\unrar
+//     bench.cpp ..\lib\Release\x64\librarres.lib
+//
+// Usage:
+//   bench small packfile  Load entries up to 1 KB, report entries per second.
+//   bench pool            Thread pool task throughput and WaitDone latency.
+//   bench pages packfile  Decode speed of a large dictionary pack for each
+//                         large pages mode.
+#include "rar.hpp"
+#include "librarres.h"
+
+#include <chrono>
+#include <vector>
+#include <string>
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Collects ids of small files found in the pack.
+struct SmallFiles : JRES::IResVisitor {
+  std::vector<std::string> ids;
+  virtual bool Visit(const char* id, unsigned long long size, bool dir) {
+    if (!dir && size <= 1024)
+      ids.push_back(id);
+    return true;
+  }
+};
+
+//Small entries benchmark. Loads all entries up to 1 KB from the pack
+//and reports entries per second, measures per file setup of decoder.
+static int BenchSmall(const char* filename) {
+  JRES::IRes* res = JRES::CreateRarRes(false);
+  if (!res->Open(filename, '/')) {
+    printf("Cannot open %s\n", filename);
+    res->Release();
+    return 1;
+  }
+  SmallFiles files;
+  res->FindResources("*", &files);
+
+  const unsigned int passes = 20;
+  unsigned int errors = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < passes; i++)
+    for (auto& id : files.ids) {
+      char* buf = nullptr;
+      size_t bufsize = 0;
+      void* data = res->LoadResource(id.c_str(), &buf, bufsize);
+      if (data == nullptr)
+        errors++;
+      res->FreeResource(data);
+    }
+  double seconds = Seconds(start);
+  printf("%u entries, %.0f entries per second, %u errors\n",
+    (unsigned int)files.ids.size(), files.ids.size() * passes / seconds, errors);
+  res->Release();
+  return errors == 0 ? 0 : 1;
+}
+
+static THREAD_PROC(BenchEmptyTask) {
+}
+
+//Thread pool microbenchmark. Measures the number of empty tasks executed
+//per second when adding them in batches and the time from WaitDone call
+//to return for a single short task.
+static int BenchPool() {
+  const unsigned int batch_size = 64, batches = 20000, waits = 20000;
+  static byte data[batch_size];
+  ThreadPool* pool = CreateThreadPool();
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < batches; i++) {
+    pool->AddTasks(BenchEmptyTask, data, 1, batch_size);
+    pool->WaitDone();
+  }
+  printf("Tasks per second: %.0f\n", batch_size * batches / Seconds(start));
+
+  start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < waits; i++) {
+    pool->AddTask(BenchEmptyTask, NULL);
+    pool->WaitDone();
+  }
+  printf("WaitDone latency: %.2f us\n", Seconds(start) * 1e6 / waits);
+
+  DestroyThreadPool(pool);
+  return 0;
+}
+
+//Collects ids and total size of files found in the pack.
+struct PackFiles : JRES::IResVisitor {
+  std::vector<std::string> ids;
+  unsigned long long total = 0;
+  virtual bool Visit(const char* id, unsigned long long size, bool dir) {
+    if (!dir) {
+      ids.push_back(id);
+      total += size;
+    }
+    return true;
+  }
+};
+
+//Large pages benchmark. Decodes all files of a pack, which should use
+//a large dictionary with long distance matches, and reports unpacked
+//data throughput for every large pages mode. Pooled windows are freed
+//before each mode, so they are allocated again with new pages.
+static int BenchPages(const char* filename) {
+  const unsigned int passes = 3;
+  static const char* mode_names[] = {"off", "advise", "explicit"};
+  unsigned int errors = 0;
+  for (int mode = LARGE_PAGES_OFF; mode <= LARGE_PAGES_EXPLICIT; mode++) {
+    SetLargePages((LARGE_PAGES_MODE)mode);
+    JRES::TrimWindowCache();
+    JRES::IRes* res = JRES::CreateRarRes(false);
+    if (!res->Open(filename, '/')) {
+      printf("Cannot open %s\n", filename);
+      res->Release();
+      return 1;
+    }
+    PackFiles files;
+    res->FindResources("*", &files);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < passes; i++)
+      for (auto& id : files.ids) {
+        char* buf = nullptr;
+        size_t bufsize = 0;
+        void* data = res->LoadResource(id.c_str(), &buf, bufsize);
+        if (data == nullptr)
+          errors++;
+        res->FreeResource(data);
+      }
+    printf("Large pages %s: %.0f MB/s\n", mode_names[mode],
+      files.total * passes / Seconds(start) / 1e6);
+    res->Release();
+  }
+  printf("%u errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 2 && strcmp(argv[1], "small") == 0)
+    return BenchSmall(argv[2]);
+  if (argc > 1 && strcmp(argv[1], "pool") == 0)
+    return BenchPool();
+  if (argc > 2 && strcmp(argv[1], "pages") == 0)
+    return BenchPages(argv[2]);
+  printf("Usage: bench small packfile | pool | pages packfile\n");
+  return 1;
+}
@@ -0,0 +1,94 @@
+// test.cpp: checks of librarres behavior on small built-in packs.
+//
+// Not a part of rarres.sln. Link it with librarres.lib, for example:
+//   cl /O2 /EHsc /I.. test.cpp ..\lib\Release\x64\librarres.lib
+// Returns 0 if all checks pass.
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "librarres.h"
+
+//RAR5 packs with archive comment "comment" and file a.txt "abc", the second
+//one also has file CMT "file".
+static const unsigned char comment_pack[] = {
+  0x52, 0x61, 0x72, 0x21, 0x1a, 0x07, 0x01, 0x00, 0xc5, 0x1a, 0x33, 0x32,
+  0x03, 0x01, 0x00, 0x00, 0x6e, 0xfc, 0xdb, 0xa4, 0x14, 0x03, 0x02, 0x07,
+  0x06, 0x07, 0x20, 0x00, 0x2f, 0x68, 0x59, 0x6c, 0x52, 0x74, 0x94, 0x00,
+  0x00, 0x03, 0x43, 0x4d, 0x54, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 0x74,
+  0xc8, 0xd7, 0x47, 0x91, 0x16, 0x02, 0x02, 0x03, 0x06, 0x03, 0x20, 0x00,
+  0x2f, 0x68, 0x59, 0xc2, 0x41, 0x24, 0x35, 0x00, 0x00, 0x05, 0x61, 0x2e,
+  0x74, 0x78, 0x74, 0x61, 0x62, 0x63, 0x19, 0xb2, 0x3a, 0x35, 0x03, 0x05,
+  0x00, 0x00,
+};
+static const unsigned char comment_file_pack[] = {
+  0x52, 0x61, 0x72, 0x21, 0x1a, 0x07, 0x01, 0x00, 0xc5, 0x1a, 0x33, 0x32,
+  0x03, 0x01, 0x00, 0x00, 0x6e, 0xfc, 0xdb, 0xa4, 0x14, 0x03, 0x02, 0x07,
+  0x06, 0x07, 0x20, 0x00, 0x2f, 0x68, 0x59, 0x6c, 0x52, 0x74, 0x94, 0x00,
+  0x00, 0x03, 0x43, 0x4d, 0x54, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 0x74,
+  0xc8, 0xd7, 0x47, 0x91, 0x16, 0x02, 0x02, 0x03, 0x06, 0x03, 0x20, 0x00,
+  0x2f, 0x68, 0x59, 0xc2, 0x41, 0x24, 0x35, 0x00, 0x00, 0x05, 0x61, 0x2e,
+  0x74, 0x78, 0x74, 0x61, 0x62, 0x63, 0x98, 0xf0, 0x83, 0x65, 0x14, 0x02,
+  0x02, 0x04, 0x06, 0x04, 0x20, 0x00, 0x2f, 0x68, 0x59, 0x10, 0x36, 0x9f,
+  0x8c, 0x00, 0x00, 0x03, 0x43, 0x4d, 0x54, 0x66, 0x69, 0x6c, 0x65, 0x19,
+  0xb2, 0x3a, 0x35, 0x03, 0x05, 0x00, 0x00,
+};
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+//Collects ids of visited entries.
+struct Ids : JRES::IResVisitor {
+  std::vector<std::string> ids;
+  virtual bool Visit(const char* id, unsigned long long /*size*/, bool /*dir*/) {
+    ids.push_back(id);
+    return true;
+  }
+};
+
+static std::string Load(JRES::IRes* res, const char* id) {
+  char* buf = nullptr;
+  size_t bufsize = 0;
+  void* data = res->LoadResource(id, &buf, bufsize);
+  if (data == nullptr)
+    return "(none)";
+  std::string s(buf, bufsize);
+  res->FreeResource(data);
+  return s;
+}
+
+//Archive comment and other service headers are not resources.
+static void TestComment() {
+  JRES::IRes* res = JRES::CreateRarRes(false);
+  Check(res->OpenMemory(comment_pack, sizeof(comment_pack), '/'), "open comment pack");
+  Ids listed, found;
+  res->ListResources("", true, &listed);
+  res->FindResources("*", &found);
+  Check(listed.ids.size() == 1 && listed.ids[0] == "a.txt", "comment is not listed");
+  Check(found.ids.size() == 1 && found.ids[0] == "a.txt", "comment is not found");
+  Check(Load(res, "CMT") == "(none)", "comment is not loaded");
+  Check(Load(res, "a.txt") == "abc", "file is loaded");
+  res->Release();
+
+  res = JRES::CreateRarRes(true);
+  Check(res->OpenMemory(comment_file_pack, sizeof(comment_file_pack), '/'),
+    "open comment and file pack");
+  Ids all;
+  res->ListResources("", true, &all);
+  Check(all.ids.size() == 2, "file named CMT is listed once");
+  Check(Load(res, "cmt") == "file", "file named CMT is loaded instead of comment");
+  res->Release();
+}
+
+int main() {
+  TestComment();
+  printf(failures ? "%d checks failed\n" : "All checks passed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -1,9 +1,10 @@
 #include "rar.hpp"
 
 #include "arccmt.cpp"
+#include "arcmem.cpp"
 
 
-Archive::Archive(RAROptions *InitCmd)
+Archive::Archive(RAROptions *InitCmd):HeadRaw(this)
 {
   Cmd=NULL; // Just in case we'll have an exception in 'new' below.
 
@@ -50,6 +51,11 @@ Archive::Archive(RAROptions *InitCmd)
   ProhibitQOpen=false;
 #endif
 
+  HeaderScan=false;
+  ScanBufPos=0;
+  ScanBufData=0;
+  ScanReadSize=0;
+  ScanPos=0;
 }
 
 
@@ -299,39 +305,190 @@ uint Archive::FullHeaderSize(size_t Size)
 
 
 
-#ifdef USE_QOPEN
 bool Archive::Open(const wchar *Name,uint Mode)
 {
+#ifdef USE_QOPEN
   // Important if we reuse Archive object and it has virtual QOpen
   // file position not matching real. For example, for 'l -v volname'.
   QOpen.Unload();
+#endif
+  ArcMem.Unload();
 
   return File::Open(Name,Mode);
 }
 
 
+// Use the archive image in memory instead of file. Data is not copied
+// and must stay valid until Close. Name is only used in messages.
+void Archive::OpenMemory(const byte *Data,size_t Size,const wchar *Name)
+{
+  Close();
+#ifdef USE_QOPEN
+  QOpen.Unload();
+#endif
+  ArcMem.Load(Data,Size);
+  wcsncpyz(FileName,Name,ASIZE(FileName));
+}
+
+
+// Read the archive with callback, for example, from some part of another
+// file or from application cache. Proc must be safe to call from several
+// threads at once if archive data is read concurrently.
+void Archive::OpenReader(ARCMEM_READ_PROC Proc,void *Param,uint64 Size,const wchar *Name)
+{
+  Close();
+#ifdef USE_QOPEN
+  QOpen.Unload();
+#endif
+  ArcMem.Load(Proc,Param,Size);
+  wcsncpyz(FileName,Name,ASIZE(FileName));
+}
+
+
 int Archive::Read(void *Data,size_t Size)
 {
-  size_t Result;
-  if (QOpen.Read(Data,Size,Result))
-    return (int)Result;
+#ifdef USE_QOPEN
+  size_t QResult;
+  if (QOpen.Read(Data,Size,QResult))
+    return (int)QResult;
+#endif
+  int Result;
+  if (ArcMem.Read(Data,Size,Result))
+    return CheckMemRead(Result);
+  if (HeaderScan)
+    return ScanRead(Data,Size);
   return File::Read(Data,Size);
 }
 
 
+int Archive::PRead(void *Data,size_t Size,int64 Offset)
+{
+  int Result;
+  if (ArcMem.PRead(Data,Size,Offset,Result))
+    return CheckMemRead(Result);
+  return File::PRead(Data,Size,Offset);
+}
+
+
+int Archive::CheckMemRead(int Result)
+{
+  if (Result<0)
+    ErrorType=FILE_READERROR;
+  return Result;
+}
+
+
 void Archive::Seek(int64 Offset,int Method)
 {
-  if (!QOpen.Seek(Offset,Method))
-    File::Seek(Offset,Method);
+#ifdef USE_QOPEN
+  if (QOpen.Seek(Offset,Method))
+    return;
+#endif
+  if (ArcMem.Seek(Offset,Method))
+    return;
+  if (HeaderScan)
+  {
+    if (Method==SEEK_SET)
+      ScanPos=Offset;
+    if (Method==SEEK_CUR)
+      ScanPos+=Offset;
+    if (Method==SEEK_END)
+    {
+      File::Seek(Offset,SEEK_END);
+      ScanPos=File::Tell();
+    }
+    return;
+  }
+  File::Seek(Offset,Method);
 }
 
 
 int64 Archive::Tell()
 {
-  int64 QPos;
-  if (QOpen.Tell(&QPos))
-    return QPos;
+  int64 Pos;
+#ifdef USE_QOPEN
+  if (QOpen.Tell(&Pos))
+    return Pos;
+#endif
+  if (ArcMem.Tell(&Pos))
+    return Pos;
+  if (HeaderScan)
+    return ScanPos;
   return File::Tell();
 }
-#endif
+
+
+// Read headers through a large window instead of issuing small reads
+// for every header and seeks over file data. Call before listing many
+// headers and disable before reading file data with Read.
+void Archive::SetHeaderScan(bool Mode)
+{
+  if (Mode==HeaderScan || ArcMem.IsLoaded())
+    return;
+  if (Mode)
+  {
+    ScanPos=File::Tell();
+    ScanBufPos=0;
+    ScanBufData=0;
+    ScanReadSize=HEADER_SCAN_MIN;
+    ScanBuf.Alloc(HEADER_SCAN_MAX);
+  }
+  else
+  {
+    File::Seek(ScanPos,SEEK_SET);
+    ScanBuf.Reset();
+  }
+  HeaderScan=Mode;
+}
+
+
+int Archive::ScanRead(void *Data,size_t Size)
+{
+  if (ScanPos<ScanBufPos || ScanPos+(int64)Size>ScanBufPos+(int64)ScanBufData)
+  {
+    // Large reads are not worth buffering.
+    if (Size>HEADER_SCAN_MAX/2)
+    {
+      int ReadSize=File::PRead(Data,Size,ScanPos);
+      if (ReadSize>0)
+        ScanPos+=ReadSize;
+      return ReadSize;
+    }
+    // Grow the window while headers are close to each other and shrink it
+    // after jumps over large file data, which would be read for nothing.
+    int64 WindowEnd=ScanBufPos+ScanBufData;
+    if (ScanPos>=ScanBufPos && ScanPos<=WindowEnd+(int64)ScanReadSize)
+      ScanReadSize=Min(ScanReadSize*2,HEADER_SCAN_MAX);
+    else
+      ScanReadSize=HEADER_SCAN_MIN;
+    int ReadSize=File::PRead(&ScanBuf[0],Max(ScanReadSize,Size),ScanPos);
+    if (ReadSize<0)
+      return -1;
+    ScanBufPos=ScanPos;
+    ScanBufData=ReadSize;
+  }
+  size_t CopySize=(size_t)Min((int64)Size,ScanBufPos+(int64)ScanBufData-ScanPos);
+  memcpy(Data,&ScanBuf[(size_t)(ScanPos-ScanBufPos)],CopySize);
+  ScanPos+=CopySize;
+  return (int)CopySize;
+}
+
+
+bool Archive::Close()
+{
+  if (HeaderScan)
+  {
+    HeaderScan=false;
+    ScanBuf.Reset();
+  }
+  if (ArcMem.Unload())
+    return true;
+  return File::Close();
+}
+
+
+bool Archive::IsOpened()
+{
+  return ArcMem.IsLoaded() || File::IsOpened();
+}
 
@@ -23,6 +23,10 @@ enum ADDSUBDATA_FLAGS
 // RAR5 headers must not exceed 2 MB.
 #define MAX_HEADER_SIZE_RAR5 0x200000
 
+// Header scan window size is adjusted between these values.
+#define HEADER_SCAN_MIN 0x2000
+#define HEADER_SCAN_MAX 0x100000
+
 class Archive:public File
 {
   private:
@@ -40,6 +44,8 @@ class Archive:public File
     void UnkEncVerMsg(const wchar *Name);
     void UnkEncVerMsg();
     bool ReadCommentData(Array<wchar> *CmtData);
+    int CheckMemRead(int Result);
+    int ScanRead(void *Data,size_t Size);
 
 #if !defined(RAR_NOCRYPT)
     CryptData HeadersCrypt;
@@ -58,6 +64,17 @@ class Archive:public File
     QuickOpen QOpen;
     bool ProhibitQOpen;
 #endif
+    ArcMemory ArcMem;
+
+    RawRead HeadRaw; // Reused by ReadHeader50.
+
+    // Header scan window, see SetHeaderScan.
+    bool HeaderScan;
+    Array<byte> ScanBuf;
+    int64 ScanBufPos;    // Archive position of ScanBuf data.
+    size_t ScanBufData;  // Number of valid bytes in ScanBuf.
+    size_t ScanReadSize; // Current window read size.
+    int64 ScanPos;       // Archive position in scan mode.
   public:
     Archive(RAROptions *InitCmd=NULL);
     ~Archive();
@@ -91,11 +108,19 @@ class Archive:public File
 #if 0
     void GetRecoveryInfo(bool Required,int64 *Size,int *Percent);
 #endif
-#ifdef USE_QOPEN
     bool Open(const wchar *Name,uint Mode=FMF_READ);
     int Read(void *Data,size_t Size);
+    int PRead(void *Data,size_t Size,int64 Offset);
     void Seek(int64 Offset,int Method);
     int64 Tell();
+    bool Close();
+    bool IsOpened();
+    void OpenMemory(const byte *Data,size_t Size,const wchar *Name);
+    const byte* GetMemory() {return ArcMem.GetData();}
+    void OpenReader(ARCMEM_READ_PROC Proc,void *Param,uint64 Size,const wchar *Name);
+    uint64 GetMemorySize() {return ArcMem.GetSize();}
+    void SetHeaderScan(bool Mode);
+#ifdef USE_QOPEN
     void QOpenUnload() {QOpen.Unload();}
     void SetProhibitQOpen(bool Mode) {ProhibitQOpen=Mode;}
 #endif
@@ -1,14 +1,32 @@
 ArcMemory::ArcMemory()
 {
   Loaded=false;
+  ArcData=NULL;
+  ReadProc=NULL;
+  ReadParam=NULL;
+  ArcSize=0;
   SeekPos=0;
 }
 
 
 void ArcMemory::Load(const byte *Data,size_t Size)
 {
-  ArcData.Alloc(Size);
-  memcpy(&ArcData[0],Data,Size);
+  ArcData=Data;
+  ReadProc=NULL;
+  ReadParam=NULL;
+  ArcSize=Size;
+  Loaded=true;
+  SeekPos=0;
+}
+
+
+// Read the archive with callback instead of addressing it directly.
+void ArcMemory::Load(ARCMEM_READ_PROC Proc,void *Param,uint64 Size)
+{
+  ArcData=NULL;
+  ReadProc=Proc;
+  ReadParam=Param;
+  ArcSize=Size;
   Loaded=true;
   SeekPos=0;
 }
@@ -19,17 +37,41 @@ bool ArcMemory::Unload()
   if (!Loaded)
     return false;
   Loaded=false;
+  ArcData=NULL;
+  ReadProc=NULL;
+  ReadParam=NULL;
+  ArcSize=0;
+  return true;
+}
+
+
+bool ArcMemory::Read(void *Data,size_t Size,int &Result)
+{
+  if (!PRead(Data,Size,SeekPos,Result))
+    return false;
+  if (Result>0)
+    SeekPos+=Result;
   return true;
 }
 
 
-bool ArcMemory::Read(void *Data,size_t Size,size_t &Result)
+// Read from Offset without changing the seek position. Does not modify
+// the object, so it is safe to call from several threads at once.
+bool ArcMemory::PRead(void *Data,size_t Size,uint64 Offset,int &Result)
 {
   if (!Loaded)
     return false;
-  Result=(size_t)Min(Size,ArcData.Size()-SeekPos);
-  memcpy(Data,&ArcData[(size_t)SeekPos],Result);
-  SeekPos+=Result;
+  size_t ReadSize=Offset<ArcSize ? (size_t)Min(Size,ArcSize-Offset) : 0;
+  if (ReadSize==0)
+    Result=0;
+  else
+    if (ArcData!=NULL)
+    {
+      memcpy(Data,ArcData+(size_t)Offset,ReadSize);
+      Result=(int)ReadSize;
+    }
+    else
+      Result=ReadProc(ReadParam,Data,ReadSize,Offset);
   return true;
 }
 
@@ -43,16 +85,16 @@ bool ArcMemory::Seek(int64 Offset,int Method)
     if (Offset<0)
       SeekPos=0;
     else
-      SeekPos=Min((uint64)Offset,ArcData.Size());
+      SeekPos=Min((uint64)Offset,ArcSize);
   }
   else
     if (Method==SEEK_CUR || Method==SEEK_END)
     {
       if (Method==SEEK_END)
-        SeekPos=ArcData.Size();
+        SeekPos=ArcSize;
       SeekPos+=(uint64)Offset;
-      if (SeekPos>ArcData.Size())
-        SeekPos=Offset<0 ? 0 : ArcData.Size();
+      if (SeekPos>ArcSize)
+        SeekPos=Offset<0 ? 0 : ArcSize;
     }
   return true;
 }
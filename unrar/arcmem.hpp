@@ -1,22 +1,35 @@
 #ifndef _RAR_ARCMEM_
 #define _RAR_ARCMEM_
 
-// Memory interface for software fuzzers.
+// Memory interface for software fuzzers and archives embedded in memory
+// or in other files. Data is referenced, not copied, and must stay valid
+// until Unload.
+
+// Read up to Size bytes at Offset. Return the number of bytes read
+// or -1 in case of error. Can be called from several threads at once.
+typedef int (*ARCMEM_READ_PROC)(void *Param,void *Data,size_t Size,uint64 Offset);
 
 class ArcMemory
 {
   private:
     bool Loaded;
-    Array<byte> ArcData;
+    const byte *ArcData;
+    ARCMEM_READ_PROC ReadProc;
+    void *ReadParam;
+    uint64 ArcSize;
     uint64 SeekPos;
   public:
     ArcMemory();
     void Load(const byte *Data,size_t Size);
+    void Load(ARCMEM_READ_PROC Proc,void *Param,uint64 Size);
     bool Unload();
     bool IsLoaded() {return Loaded;}
-    bool Read(void *Data,size_t Size,size_t &Result);
+    bool Read(void *Data,size_t Size,int &Result);
+    bool PRead(void *Data,size_t Size,uint64 Offset,int &Result);
     bool Seek(int64 Offset,int Method);
     bool Tell(int64 *Pos);
+    const byte* GetData() {return Loaded ? ArcData:NULL;}
+    uint64 GetSize() {return Loaded ? ArcSize:0;}
 };
 
 #endif
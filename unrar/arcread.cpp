@@ -546,7 +546,10 @@ size_t Archive::ReadHeader15()
 
 size_t Archive::ReadHeader50()
 {
-  RawRead Raw(this);
+  // Reuse the header buffer, so listing many small files does not
+  // allocate memory for every header.
+  RawRead &Raw=HeadRaw;
+  Raw.Reset();
 
   bool Decrypt=Encrypted && CurBlockPos>(int64)SFXSize+SIZEOF_MARKHEAD5;
 
@@ -649,6 +652,8 @@ size_t Archive::ReadHeader50()
     UnexpEndArcMsg();
     return 0;
   }
+  // Raw is overwritten if QOpen.Load below reads headers recursively.
+  size_t ReadSize=Raw.Size();
 
   uint HeaderCRC=Raw.GetCRC50();
 
@@ -756,7 +761,9 @@ size_t Archive::ReadHeader50()
           ProcessExtra50(&Raw,(size_t)ExtraSize,&MainHead);
 
 #ifdef USE_QOPEN
-        if (!ProhibitQOpen && MainHead.Locator && MainHead.QOpenOffset>0 && Cmd->QOpenMode!=QOPEN_NONE)
+        // Quick open reads the file directly, it is of no use for archive
+        // image in memory anyway.
+        if (!ProhibitQOpen && !ArcMem.IsLoaded() && MainHead.Locator && MainHead.QOpenOffset>0 && Cmd->QOpenMode!=QOPEN_NONE)
         {
           // We seek to QO block in the end of archive when processing
           // QOpen.Load, so we need to preserve current block positions
@@ -892,7 +899,7 @@ size_t Archive::ReadHeader50()
       break;
   }
 
-  return Raw.Size();
+  return ReadSize;
 }
 
 
@@ -2,10 +2,6 @@
 
 #include "rar.hpp"
 
-#ifdef USE_SSE
-#include "blake2s_sse.cpp"
-#endif
-
 static void blake2s_init_param( blake2s_state *S, uint32 node_offset, uint32 node_depth);
 static void blake2s_update( blake2s_state *S, const byte *in, size_t inlen );
 static void blake2s_final( blake2s_state *S, byte *digest );
@@ -32,6 +28,10 @@ static const byte blake2s_sigma[10][16] =
   { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13 , 0 } ,
 };
 
+#ifdef USE_SSE
+#include "blake2s_sse.cpp"
+#endif
+
 static inline void blake2s_set_lastnode( blake2s_state *S )
 {
   S->f[1] = ~0U;
@@ -58,7 +58,7 @@ static inline void blake2s_increment_counter( blake2s_state *S, const uint32 inc
 void blake2s_init_param( blake2s_state *S, uint32 node_offset, uint32 node_depth)
 {
 #ifdef USE_SSE
-  if (_SSE_Version>=SSE_SSE2)
+  if ((GetCPUFeatures() & CPU_SSE2)!=0)
     blake2s_init_sse();
 #endif
 
@@ -120,6 +120,27 @@ static void blake2s_compress( blake2s_state *S, const byte block[BLAKE2S_BLOCKBY
 }
 
 
+static void blake2s_compress_select( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] );
+
+// Set to the best compression function for current CPU on first call.
+static std::atomic<void (*)( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )> blake2s_compress_proc( blake2s_compress_select );
+
+void blake2s_compress_select( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
+{
+  void (*Proc)( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] ) = blake2s_compress;
+#ifdef USE_SSE
+#ifdef BLAKE2_SSSE3
+  if ((GetCPUFeatures() & CPU_SSSE3)!=0)
+#else
+  if ((GetCPUFeatures() & CPU_SSE2)!=0)
+#endif
+    Proc = blake2s_compress_sse;
+#endif
+  blake2s_compress_proc.store( Proc, std::memory_order_relaxed );
+  Proc( S, block );
+}
+
+
 void blake2s_update( blake2s_state *S, const byte *in, size_t inlen )
 {
   while( inlen > 0 )
@@ -133,18 +154,7 @@ void blake2s_update( blake2s_state *S, const byte *in, size_t inlen )
       S->buflen += fill;
       blake2s_increment_counter( S, BLAKE2S_BLOCKBYTES );
 
-#ifdef USE_SSE
-#ifdef _WIN_32 // We use SSSE3 _mm_shuffle_epi8 only in x64 mode.
-      if (_SSE_Version>=SSE_SSE2)
-#else
-      if (_SSE_Version>=SSE_SSSE3)
-#endif
-        blake2s_compress_sse( S, S->buf );
-      else
-        blake2s_compress( S, S->buf ); // Compress
-#else
-      blake2s_compress( S, S->buf ); // Compress
-#endif
+      blake2s_compress_proc.load( std::memory_order_relaxed )( S, S->buf ); // Compress
       
       memcpy( S->buf, S->buf + BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES ); // Shift buffer left
       S->buflen -= BLAKE2S_BLOCKBYTES;
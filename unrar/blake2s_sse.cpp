@@ -1,11 +1,14 @@
 // Based on public domain code written in 2012 by Samuel Neves
 
-extern const byte blake2s_sigma[10][16];
+// We use SSSE3 _mm_shuffle_epi8 only in 64-bit mode.
+#if defined(_WIN_64) || defined(__x86_64__)
+#define BLAKE2_SSSE3
+#endif
 
 // Initialization vector.
 static __m128i blake2s_IV_0_3, blake2s_IV_4_7;
 
-#ifdef _WIN_64
+#ifdef BLAKE2_SSSE3
 // Constants for cyclic rotation. Used in 64-bit mode in mm_rotr_epi32 macro.
 static __m128i crotr8, crotr16;
 #endif
@@ -24,7 +27,7 @@ static void blake2s_init_sse()
   blake2s_IV_0_3 = _mm_setr_epi32( 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A );
   blake2s_IV_4_7 = _mm_setr_epi32( 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 );
 
-#ifdef _WIN_64
+#ifdef BLAKE2_SSSE3
   crotr8 = _mm_set_epi8( 12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1 );
   crotr16 = _mm_set_epi8( 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2 );
 #endif
@@ -34,7 +37,7 @@ static void blake2s_init_sse()
 #define LOAD(p)  _mm_load_si128( (__m128i *)(p) )
 #define STORE(p,r) _mm_store_si128((__m128i *)(p), r)
 
-#ifdef _WIN_32
+#ifndef BLAKE2_SSSE3
 // 32-bit mode has less SSE2 registers and in MSVC2008 it is more efficient
 // to not use _mm_shuffle_epi8 here.
 #define mm_rotr_epi32(r, c) ( \
@@ -101,7 +104,10 @@ static void blake2s_init_sse()
 }
 
 
-static int blake2s_compress_sse( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
+#ifdef BLAKE2_SSSE3
+SSE_TARGET("ssse3")
+#endif
+static void blake2s_compress_sse( blake2s_state *S, const byte block[BLAKE2S_BLOCKBYTES] )
 {
   __m128i row[4];
   __m128i ff0, ff1;
@@ -125,5 +131,4 @@ static int blake2s_compress_sse( blake2s_state *S, const byte block[BLAKE2S_BLOC
   SSE_ROUND( m, row, 9 );
   STORE( &S->h[0], _mm_xor_si128( ff0, _mm_xor_si128( row[0], row[2] ) ) );
   STORE( &S->h[4], _mm_xor_si128( ff1, _mm_xor_si128( row[1], row[3] ) ) );
-  return 0;
 }
@@ -46,7 +46,7 @@ void Blake2ThreadData::Update()
   {
 #ifdef USE_SSE
     // We gain 5% in i7 SSE mode by prefetching next data block.
-    if (_SSE_Version>=SSE_SSE && inlen__ >= 2 * PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES)
+    if ((GetCPUFeatures() & CPU_SSE)!=0 && inlen__ >= 2 * PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES)
       _mm_prefetch((char*)(in__ +  PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES), _MM_HINT_T0);
 #endif
     blake2s_update( S, in__, BLAKE2S_BLOCKBYTES );
@@ -94,7 +94,8 @@ void blake2sp_update( blake2sp_state *S, const byte *in, size_t inlen )
 
   for (size_t id__=0;id__<PARALLELISM_DEGREE;)
   {
-    for (uint Thread=0;Thread<ThreadNumber && id__<PARALLELISM_DEGREE;Thread++)
+    uint Thread;
+    for (Thread=0;Thread<ThreadNumber && id__<PARALLELISM_DEGREE;Thread++)
     {
       Blake2ThreadData *btd=btd_array+Thread;
 
@@ -103,9 +104,7 @@ void blake2sp_update( blake2sp_state *S, const byte *in, size_t inlen )
       btd->S = &S->S[id__];
   
 #ifdef RAR_SMP
-      if (ThreadNumber>1)
-        S->ThPool->AddTask(Blake2Thread,(void*)btd);
-      else
+      if (ThreadNumber==1)
         btd->Update();
 #else
       btd->Update();
@@ -113,8 +112,12 @@ void blake2sp_update( blake2sp_state *S, const byte *in, size_t inlen )
       id__++;
     }
 #ifdef RAR_SMP
-    if (S->ThPool!=NULL) // Can be NULL in -mt1 mode.
+    if (ThreadNumber>1)
+    {
+      // Pass the entire group with a single call to wake workers only once.
+      S->ThPool->AddTasks(Blake2Thread,btd_array,sizeof(*btd_array),Thread);
       S->ThPool->WaitDone();
+    }
 #endif // RAR_SMP
   }
 
@@ -0,0 +1,92 @@
+// CRC32 calculation using carry-less multiplication, based on Intel
+// "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+// paper. Included from crc.cpp. Callers must check CPU_PCLMUL and CPU_SSE41.
+//
+// We fold 4 128-bit values in parallel while we have 64 bytes of data,
+// then fold them to single 128-bit value, reduce it to 64 bits and
+// finally apply Barrett reduction to get 32-bit CRC.
+
+SSE_TARGET("pclmul,sse4.1") static uint CRC32_PCLMUL(uint StartCRC,const byte *Data,size_t Size)
+{
+  // Constants for bit-reflected CRC32 polynomial, (x^(4*128+32) mod P)<<1,
+  // (x^(4*128-32) mod P)<<1 and so on, as described in the paper.
+  static const uint64 K1K2[2]={0x0154442bd4,0x01c6e41596};
+  static const uint64 K3K4[2]={0x01751997d0,0x00ccaa009e};
+  static const uint64 K5K0[2]={0x0163cd6124,0x0000000000};
+  static const uint64 Poly[2]={0x01db710641,0x01f7011641};
+
+  __m128i X1=_mm_loadu_si128((const __m128i *)(Data+0x00));
+  __m128i X2=_mm_loadu_si128((const __m128i *)(Data+0x10));
+  __m128i X3=_mm_loadu_si128((const __m128i *)(Data+0x20));
+  __m128i X4=_mm_loadu_si128((const __m128i *)(Data+0x30));
+  X1=_mm_xor_si128(X1,_mm_cvtsi32_si128(StartCRC));
+  Data+=64;
+  Size-=64;
+
+  __m128i K=_mm_loadu_si128((const __m128i *)K1K2);
+  for (;Size>=64;Size-=64,Data+=64)
+  {
+    __m128i X5=_mm_clmulepi64_si128(X1,K,0x00);
+    __m128i X6=_mm_clmulepi64_si128(X2,K,0x00);
+    __m128i X7=_mm_clmulepi64_si128(X3,K,0x00);
+    __m128i X8=_mm_clmulepi64_si128(X4,K,0x00);
+
+    X1=_mm_clmulepi64_si128(X1,K,0x11);
+    X2=_mm_clmulepi64_si128(X2,K,0x11);
+    X3=_mm_clmulepi64_si128(X3,K,0x11);
+    X4=_mm_clmulepi64_si128(X4,K,0x11);
+
+    X1=_mm_xor_si128(_mm_xor_si128(X1,X5),_mm_loadu_si128((const __m128i *)(Data+0x00)));
+    X2=_mm_xor_si128(_mm_xor_si128(X2,X6),_mm_loadu_si128((const __m128i *)(Data+0x10)));
+    X3=_mm_xor_si128(_mm_xor_si128(X3,X7),_mm_loadu_si128((const __m128i *)(Data+0x20)));
+    X4=_mm_xor_si128(_mm_xor_si128(X4,X8),_mm_loadu_si128((const __m128i *)(Data+0x30)));
+  }
+
+  // Fold 4 values to one.
+  K=_mm_loadu_si128((const __m128i *)K3K4);
+  __m128i X5=_mm_clmulepi64_si128(X1,K,0x00);
+  X1=_mm_clmulepi64_si128(X1,K,0x11);
+  X1=_mm_xor_si128(_mm_xor_si128(X1,X2),X5);
+
+  X5=_mm_clmulepi64_si128(X1,K,0x00);
+  X1=_mm_clmulepi64_si128(X1,K,0x11);
+  X1=_mm_xor_si128(_mm_xor_si128(X1,X3),X5);
+
+  X5=_mm_clmulepi64_si128(X1,K,0x00);
+  X1=_mm_clmulepi64_si128(X1,K,0x11);
+  X1=_mm_xor_si128(_mm_xor_si128(X1,X4),X5);
+
+  // Fold remaining 16 byte blocks.
+  for (;Size>=16;Size-=16,Data+=16)
+  {
+    X5=_mm_clmulepi64_si128(X1,K,0x00);
+    X1=_mm_clmulepi64_si128(X1,K,0x11);
+    X1=_mm_xor_si128(_mm_xor_si128(X1,_mm_loadu_si128((const __m128i *)Data)),X5);
+  }
+
+  // Reduce 128 bits to 64 bits.
+  __m128i Mask32=_mm_setr_epi32(~0,0,~0,0);
+  X2=_mm_clmulepi64_si128(X1,K,0x10);
+  X1=_mm_xor_si128(_mm_srli_si128(X1,8),X2);
+
+  K=_mm_loadl_epi64((const __m128i *)K5K0);
+  X2=_mm_srli_si128(X1,4);
+  X1=_mm_and_si128(X1,Mask32);
+  X1=_mm_clmulepi64_si128(X1,K,0x00);
+  X1=_mm_xor_si128(X1,X2);
+
+  // Barrett reduction to 32 bits.
+  K=_mm_loadu_si128((const __m128i *)Poly);
+  X2=_mm_and_si128(X1,Mask32);
+  X2=_mm_clmulepi64_si128(X2,K,0x10);
+  X2=_mm_and_si128(X2,Mask32);
+  X2=_mm_clmulepi64_si128(X2,K,0x00);
+  X1=_mm_xor_si128(X1,X2);
+
+  StartCRC=(uint)_mm_extract_epi32(X1,1);
+
+  // Process the tail shorter than 16 bytes.
+  for (;Size>0;Size--,Data++)
+    StartCRC=crc_tables[0][(byte)(StartCRC^Data[0])]^(StartCRC>>8);
+  return StartCRC;
+}
@@ -95,28 +95,51 @@ void pbkdf2(const byte *Pwd, size_t PwdLength,
   SaltData[SaltLength + 2] = 0;
   SaltData[SaltLength + 3] = 1;
 
+  sha256_context ICtxOpt,RCtxOpt;
+  bool SetIOpt=false,SetROpt=false;
+
   // First iteration: HMAC of password, salt and block index (1).
+  // Also store inner and outer padded key contexts for further reuse.
   byte U1[SHA256_DIGEST_SIZE];
-  hmac_sha256(Pwd, PwdLength, SaltData, SaltLength + 4, U1, NULL, NULL, NULL, NULL);
+  hmac_sha256(Pwd, PwdLength, SaltData, SaltLength + 4, U1, &ICtxOpt, &SetIOpt, &RCtxOpt, &SetROpt);
   byte Fn[SHA256_DIGEST_SIZE]; // Current function value.
   memcpy(Fn, U1, sizeof(Fn)); // Function at first iteration.
 
+  // Following iterations hash 32 byte digests after already processed
+  // 64 byte padded key. So both inner and outer hash data fit a single
+  // block with constant padding and length, which we prepare only once
+  // and then call the block transform directly, avoiding buffer copying
+  // and finalization overhead of sha256_process and sha256_done.
+  const size_t Sha256BlockSize=64;
+  byte IBlock[Sha256BlockSize],OBlock[Sha256BlockSize];
+  memset(IBlock, 0, sizeof(IBlock));
+  IBlock[SHA256_DIGEST_SIZE] = 0x80; // Padding "1" bit.
+  RawPutBE4((Sha256BlockSize + SHA256_DIGEST_SIZE) * 8, IBlock + 60); // Bit length.
+  memcpy(OBlock, IBlock, sizeof(OBlock));
+  memcpy(IBlock, U1, SHA256_DIGEST_SIZE);
+
   uint  CurCount[] = { Count-1, 16, 16 };
   byte *CurValue[] = { Key    , V1, V2 };
   
-  sha256_context ICtxOpt,RCtxOpt;
-  bool SetIOpt=false,SetROpt=false;
-  
-  byte U2[SHA256_DIGEST_SIZE];
+  uint32 H[8];
   for (uint I = 0; I < 3; I++) // For output key and 2 supplementary values.
   {
     for (uint J = 0; J < CurCount[I]; J++) 
     {
-      // U2 = PRF (P, U1).
-      hmac_sha256(Pwd, PwdLength, U1, sizeof(U1), U2, &ICtxOpt, &SetIOpt, &RCtxOpt, &SetROpt);
-      memcpy(U1, U2, sizeof(U1));
+      // U2 = PRF (P, U1). Inner hash of U1, stored to outer block.
+      memcpy(H, ICtxOpt.H, sizeof(H));
+      sha256_transform(H, IBlock);
+      for (uint K = 0; K < ASIZE(H); K++)
+        RawPutBE4(H[K], OBlock + K * 4);
+
+      // Outer hash, stored to inner block as U1 for next iteration.
+      memcpy(H, RCtxOpt.H, sizeof(H));
+      sha256_transform(H, OBlock);
+      for (uint K = 0; K < ASIZE(H); K++)
+        RawPutBE4(H[K], IBlock + K * 4);
+
       for (uint K = 0; K < sizeof(Fn); K++) // Function ^= U.
-        Fn[K] ^= U1[K];
+        Fn[K] ^= IBlock[K];
     }
     memcpy(CurValue[I], Fn, SHA256_DIGEST_SIZE);
   }
@@ -124,7 +147,11 @@ void pbkdf2(const byte *Pwd, size_t PwdLength,
   cleandata(SaltData, sizeof(SaltData));
   cleandata(Fn, sizeof(Fn));
   cleandata(U1, sizeof(U1));
-  cleandata(U2, sizeof(U2));
+  cleandata(IBlock, sizeof(IBlock));
+  cleandata(OBlock, sizeof(OBlock));
+  cleandata(H, sizeof(H));
+  cleandata(&ICtxOpt, sizeof(ICtxOpt));
+  cleandata(&RCtxOpt, sizeof(RCtxOpt));
 }
 
 
@@ -13,8 +13,8 @@ File::File()
   OpenShared=false;
   AllowDelete=true;
   AllowExceptions=true;
-#ifdef _WIN_ALL
   NoSequentialRead=false;
+#ifdef _WIN_ALL
   CreateMode=FMF_UNDEFINED;
 #endif
 }
@@ -132,6 +132,11 @@ bool File::Open(const wchar *Name,uint Mode)
   {
     hFile=hNewFile;
     wcsncpyz(FileName,Name,ASIZE(FileName));
+#ifndef _WIN_ALL
+    // Same as FILE_FLAG_SEQUENTIAL_SCAN in Windows.
+    if (!NoSequentialRead && !WriteMode && !UpdateMode)
+      Advise(0,0,FAH_SEQUENTIAL);
+#endif
   }
   return Success;
 }
@@ -458,6 +463,83 @@ int File::DirectRead(void *Data,size_t Size)
 }
 
 
+// Read from Offset without using or changing the file pointer, so several
+// threads can read the same handle at once. Returns -1 in case of error.
+int File::PRead(void *Data,size_t Size,int64 Offset)
+{
+  size_t TotalRead=0;
+  while (TotalRead<Size)
+  {
+#ifdef _WIN_ALL
+    // Synchronous handle still moves the file pointer here, but readers
+    // using PRead do not depend on it.
+    OVERLAPPED Ov;
+    memset(&Ov,0,sizeof(Ov));
+    Ov.Offset=(DWORD)Offset;
+    Ov.OffsetHigh=(DWORD)(Offset>>32);
+    DWORD Read;
+    if (!ReadFile(hFile,(byte *)Data+TotalRead,(DWORD)(Size-TotalRead),&Read,&Ov))
+      Read=GetLastError()==ERROR_HANDLE_EOF ? 0:(DWORD)-1;
+    int ReadSize=(int)Read;
+#elif defined(_UNIX)
+    ssize_t ReadSize=pread(GetFD(),(byte *)Data+TotalRead,Size-TotalRead,(off_t)Offset);
+    if (ReadSize==-1 && errno==EINTR)
+      continue;
+#else
+    // Not thread safe, only to keep the positional interface available.
+    int ReadSize=-1;
+    if (RawSeek(Offset,SEEK_SET))
+      ReadSize=DirectRead((byte *)Data+TotalRead,Size-TotalRead);
+#endif
+    if (ReadSize==-1)
+    {
+      ErrorType=FILE_READERROR;
+      if (AllowExceptions)
+        ErrHandler.ReadError(FileName);
+      return -1;
+    }
+    if (ReadSize==0)
+      break;
+    TotalRead+=ReadSize;
+    Offset+=ReadSize;
+  }
+  return (int)TotalRead;
+}
+
+
+// Pass the expected access to Size bytes at Offset to the system cache.
+// Size 0 means up to the end of file. Windows does not have per range hints,
+// there FILE_FLAG_SEQUENTIAL_SCAN is set in Open unless NoSequentialRead.
+void File::Advise(int64 Offset,int64 Size,FILE_ACCESS_HINT Hint)
+{
+  if (hFile==FILE_BAD_HANDLE || HandleType!=FILE_HANDLENORMAL)
+    return;
+#if defined(_UNIX) && defined(POSIX_FADV_NORMAL)
+  int Advice=POSIX_FADV_NORMAL;
+  switch (Hint)
+  {
+    case FAH_NORMAL:     Advice=POSIX_FADV_NORMAL;     break;
+    case FAH_SEQUENTIAL: Advice=POSIX_FADV_SEQUENTIAL; break;
+    case FAH_RANDOM:     Advice=POSIX_FADV_RANDOM;     break;
+    case FAH_WILLNEED:   Advice=POSIX_FADV_WILLNEED;   break;
+    case FAH_DONTNEED:   Advice=POSIX_FADV_DONTNEED;   break;
+  }
+  posix_fadvise(GetFD(),(off_t)Offset,(off_t)Size,Advice);
+#elif defined(_UNIX) && defined(F_RDADVISE)
+  // macOS has no posix_fadvise, but can switch readahead and prefetch.
+  if (Hint==FAH_WILLNEED)
+  {
+    struct radvisory ra;
+    ra.ra_offset=(off_t)Offset;
+    ra.ra_count=(int)Min(Size!=0 ? Size:FileLength()-Offset,(int64)0x7fffffff);
+    fcntl(GetFD(),F_RDADVISE,&ra);
+  }
+  if (Hint==FAH_SEQUENTIAL || Hint==FAH_RANDOM || Hint==FAH_NORMAL)
+    fcntl(GetFD(),F_RDAHEAD,Hint==FAH_RANDOM ? 0:1);
+#endif
+}
+
+
 void File::Seek(int64 Offset,int Method)
 {
   if (!RawSeek(Offset,Method) && AllowExceptions)
@@ -20,6 +20,15 @@ enum FILE_HANDLETYPE {FILE_HANDLENORMAL,FILE_HANDLESTD};
 
 enum FILE_ERRORTYPE {FILE_SUCCESS,FILE_NOTFOUND,FILE_READERROR};
 
+// Expected access to file data, passed to the system cache.
+enum FILE_ACCESS_HINT {
+  FAH_NORMAL,     // Default system readahead.
+  FAH_SEQUENTIAL, // Whole file is read in order, read ahead more.
+  FAH_RANDOM,     // Separate lookups, do not read ahead.
+  FAH_WILLNEED,   // Start reading the range to cache now.
+  FAH_DONTNEED    // Range is not needed again soon, drop it from cache.
+};
+
 enum FILE_MODE_FLAGS {
   // Request read only access to file. Default for Open.
   FMF_READ=0,
@@ -58,8 +67,8 @@ class File
     bool NewFile;
     bool AllowDelete;
     bool AllowExceptions;
-#ifdef _WIN_ALL
     bool NoSequentialRead;
+#ifdef _WIN_ALL
     uint CreateMode;
 #endif
   protected:
@@ -87,6 +96,8 @@ class File
     bool Write(const void *Data,size_t Size);
     virtual int Read(void *Data,size_t Size);
     int DirectRead(void *Data,size_t Size);
+    virtual int PRead(void *Data,size_t Size,int64 Offset); // 'virtual' for ArcMemory.
+    void Advise(int64 Offset,int64 Size,FILE_ACCESS_HINT Hint);
     virtual void Seek(int64 Offset,int Method);
     bool RawSeek(int64 Offset,int Method);
     virtual int64 Tell();
@@ -111,9 +122,8 @@ class File
     int64 Copy(File &Dest,int64 Length=INT64NDF);
     void SetAllowDelete(bool Allow) {AllowDelete=Allow;}
     void SetExceptions(bool Allow) {AllowExceptions=Allow;}
-#ifdef _WIN_ALL
+    // Call before Open if file is not read sequentially.
     void RemoveSequentialFlag() {NoSequentialRead=true;}
-#endif
 #ifdef _UNIX
     int GetFD()
     {
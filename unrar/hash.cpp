@@ -66,7 +66,9 @@ DataHash::~DataHash()
 
 void DataHash::Init(HASH_TYPE Type,uint MaxThreads)
 {
-  if (blake2ctx==NULL)
+  // Allocate BLAKE2sp state only if it is used, so CRC32 files
+  // do not need any heap allocations.
+  if (blake2ctx==NULL && Type==HASH_BLAKE2)
     blake2ctx=new blake2sp_state;
   HashType=Type;
   if (Type==HASH_RAR14)
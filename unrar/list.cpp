@@ -22,9 +22,7 @@ void ListArchive(CommandData *Cmd)
       Cmd->Password.Clean(); // Clean user entered password before processing next archive.
 
     Archive Arc(Cmd);
-#ifdef _WIN_ALL
     Arc.RemoveSequentialFlag();
-#endif
     if (!Arc.WOpen(ArcName))
       continue;
     bool FileMatched=true;
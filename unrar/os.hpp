@@ -13,6 +13,7 @@
 #endif
 
 #include <new>
+#include <atomic>
 
 
 #if defined(_WIN_ALL) || defined(_EMX)
@@ -78,6 +79,7 @@
 
   #define USE_SSE
   #define SSE_ALIGNMENT 16
+  #define SSE_TARGET(Features)
 #else
   #include <dirent.h>
 #endif // _MSC_VER
@@ -136,6 +138,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #if defined(__QNXNTO__)
   #include <sys/param.h>
 #endif
@@ -222,6 +225,19 @@
   typedef const wchar* MSGID;
 #endif
 
+// GCC 4.9+ and Clang allow to use intrinsics above the compiler target
+// instruction set in functions marked with the target attribute, so we can
+// build the portable binary selecting SIMD code at run time. SSE2 is still
+// expected to be enabled at compile time, as it is always done for x64.
+#if !defined(_MSC_VER) && (defined(__x86_64__) || defined(__i386__) && defined(__SSE2__)) && \
+    (defined(__clang__) || __GNUC__>4 || __GNUC__==4 && __GNUC_MINOR__>=9)
+  #include <immintrin.h>
+
+  #define USE_SSE
+  #define SSE_ALIGNMENT 16
+  #define SSE_TARGET(Features) __attribute__((target(Features)))
+#endif
+
 #ifndef SSE_ALIGNMENT // No SSE use and no special data alignment is required.
   #define SSE_ALIGNMENT 1
 #endif
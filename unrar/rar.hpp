@@ -45,6 +45,8 @@
 #ifdef USE_QOPEN
 #include "qopen.hpp"
 #endif
+#include "rawread.hpp"
+#include "arcmem.hpp"
 #include "archive.hpp"
 #include "match.hpp"
 #include "cmddata.hpp"
@@ -53,7 +55,6 @@
 #include "system.hpp"
 #include "log.hpp"
 #include "rawint.hpp"
-#include "rawread.hpp"
 #include "encname.hpp"
 #include "resource.hpp"
 #include "compress.hpp"
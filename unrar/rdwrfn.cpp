@@ -16,6 +16,8 @@ void ComprDataIO::Init()
   UnpackFromMemory=false;
   UnpackToMemory=false;
   UnpPackedSize=0;
+  UnpReadPos=-1;
+  NextPart=NULL;
   ShowProgress=true;
   TestMode=false;
   SkipUnpCRC=false;
@@ -94,7 +96,14 @@ int ComprDataIO::UnpRead(byte *Addr,size_t Count)
 
         if (!SrcFile->IsOpened())
           return -1;
-        ReadSize=SrcFile->Read(ReadAddr,SizeToRead);
+        if (UnpReadPos>=0)
+        {
+          ReadSize=SrcFile->PRead(ReadAddr,SizeToRead,UnpReadPos);
+          if (ReadSize>0)
+            UnpReadPos+=ReadSize;
+        }
+        else
+          ReadSize=SrcFile->Read(ReadAddr,SizeToRead);
         FileHeader *hd=SubHead!=NULL ? SubHead:&SrcArc->FileHead;
         if (!NoFileHeader && hd->SplitAfter)
           PackedDataHash.Update(ReadAddr,ReadSize);
@@ -120,6 +129,15 @@ int ComprDataIO::UnpRead(byte *Addr,size_t Count)
     if (UnpVolume && UnpPackedSize == 0 && 
         (ReadSize==0 || Decryption && (TotalRead & CRYPT_BLOCK_MASK) != 0) )
     {
+      if (NextPart!=NULL)
+      {
+        SrcFile=NextPart->SrcFile;
+        UnpReadPos=NextPart->Pos;
+        UnpPackedSize=NextPart->PackSize;
+        UnpVolume=NextPart->SplitAfter;
+        NextPart=UnpVolume ? NextPart+1:NULL;
+        continue;
+      }
 #ifndef NOVOLUME
       if (!MergeArchive(*SrcArc,this,true,CurrentCommand))
 #endif
@@ -127,6 +145,9 @@ int ComprDataIO::UnpRead(byte *Addr,size_t Count)
         NextVolumeMissing=true;
         return -1;
       }
+      // MergeArchive positions the next volume file to its packed data.
+      if (UnpReadPos>=0)
+        UnpReadPos=SrcArc->Tell();
     }
     else
       break;
@@ -312,7 +333,20 @@ void ComprDataIO::SetCmt13Encryption()
 
 
 
-void ComprDataIO::SetUnpackToMemory(byte *Addr,uint Size)
+// Packed size left in this and all next parts of split file or -1 if next
+// parts are not known until their volumes are opened.
+int64 ComprDataIO::GetTotalPackedSizeToRead()
+{
+  if (UnpVolume && NextPart==NULL)
+    return -1;
+  int64 Size=UnpPackedSize;
+  for (const VolumeDataPart *Part=NextPart;Part!=NULL;Part=Part->SplitAfter ? Part+1:NULL)
+    Size+=Part->PackSize;
+  return Size;
+}
+
+
+void ComprDataIO::SetUnpackToMemory(byte *Addr,size_t Size)
 {
   UnpackToMemory=true;
   UnpackToMemoryAddr=Addr;
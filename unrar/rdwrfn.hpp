@@ -9,6 +9,16 @@ class Unpack;
 #define COMPRDATAIO_EXTIO
 #endif
 
+// Part of file data continued in the next volume. Volumes are opened
+// in advance, so several split files can be read at once.
+struct VolumeDataPart
+{
+  File *SrcFile;
+  int64 Pos;       // Packed data position in SrcFile.
+  int64 PackSize;
+  bool SplitAfter; // Data continues in the next part.
+};
+
 class ComprDataIO
 {
   private:
@@ -29,6 +39,12 @@ class ComprDataIO
 
     int64 UnpPackedSize;
 
+    // Read position for positional reads or -1 to use the file pointer.
+    int64 UnpReadPos;
+
+    // Next part of split file or NULL to use MergeArchive.
+    const VolumeDataPart *NextPart;
+
     bool ShowProgress;
     bool TestMode;
     bool SkipUnpCRC;
@@ -61,6 +77,16 @@ class ComprDataIO
     void EnableShowProgress(bool Show) {ShowProgress=Show;}
     void GetUnpackedData(byte **Data,size_t *Size);
     void SetPackedSizeToRead(int64 Size) {UnpPackedSize=Size;}
+    int64 GetPackedSizeToRead() {return UnpPackedSize;}
+    int64 GetTotalPackedSizeToRead();
+
+    // Read packed data from Pos with File::PRead, so ComprDataIO objects
+    // of several threads can share one archive file without seeking.
+    void SetReadPos(int64 Pos) {UnpReadPos=Pos;}
+
+    // Continue reading split file from already opened volume parts
+    // instead of closing and opening volumes with MergeArchive.
+    void SetNextPart(const VolumeDataPart *Part) {NextPart=Part;}
     void SetTestMode(bool Mode) {TestMode=Mode;}
     void SetSkipUnpCRC(bool Skip) {SkipUnpCRC=Skip;}
     void SetNoFileHeader(bool Mode) {NoFileHeader=Mode;}
@@ -71,7 +97,7 @@ class ComprDataIO
          const byte *Salt,const byte *InitV,uint Lg2Cnt,byte *HashKey,byte *PswCheck);
     void SetAV15Encryption();
     void SetCmt13Encryption();
-    void SetUnpackToMemory(byte *Addr,uint Size);
+    void SetUnpackToMemory(byte *Addr,size_t Size);
     void SetCurrentCommand(wchar Cmd) {CurrentCommand=Cmd;}
 
 
@@ -314,11 +314,11 @@ void RSCoder16::UpdateECC(uint DataNum, uint ECCNum, const byte *Data, byte *ECC
 #ifdef USE_SSE
 // Data and ECC addresses must be properly aligned for SSE.
 // AVX2 did not provide a noticeable speed gain on i7-6700K here.
-bool RSCoder16::SSE_UpdateECC(uint DataNum, uint ECCNum, const byte *Data, byte *ECC, size_t BlockSize)
+SSE_TARGET("ssse3") bool RSCoder16::SSE_UpdateECC(uint DataNum, uint ECCNum, const byte *Data, byte *ECC, size_t BlockSize)
 {
   // Check data alignment and SSSE3 support.
   if ((size_t(Data) & (SSE_ALIGNMENT-1))!=0 || (size_t(ECC) & (SSE_ALIGNMENT-1))!=0 ||
-      _SSE_Version<SSE_SSSE3)
+      (GetCPUFeatures() & CPU_SSSE3)==0)
     return false;
 
   uint M=MX[ECCNum * ND + DataNum];
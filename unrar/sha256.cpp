@@ -32,6 +32,12 @@ static const uint32 K[64] =
 #define sg0(x) (rotr32(x, 7) ^ rotr32(x,18) ^ (x >> 3))
 #define sg1(x) (rotr32(x,17) ^ rotr32(x,19) ^ (x >> 10))
 
+// SHA extensions intrinsics are available in MSVC 2015+, GCC 4.9+ and Clang.
+#if defined(USE_SSE) && (!defined(_MSC_VER) || _MSC_VER>=1900)
+#define USE_SHA_NI
+#include "sha256_ni.cpp"
+#endif
+
 void sha256_init(sha256_context *ctx)
 {
   ctx->H[0] = 0x6a09e667; // Set the initial hash value.
@@ -46,18 +52,17 @@ void sha256_init(sha256_context *ctx)
 }
 
 
-static void sha256_transform(sha256_context *ctx)
+static void sha256_transform_c(uint32 *H,const byte *Data)
 {
   uint32 W[64]; // Words of message schedule.
   uint32 v[8];  // FIPS a, b, c, d, e, f, g, h working variables.
 
   // Prepare message schedule.
   for (uint I = 0; I < 16; I++)
-    W[I] = RawGetBE4(ctx->Buffer + I * 4);
+    W[I] = RawGetBE4(Data + I * 4);
   for (uint I = 16; I < 64; I++)
     W[I] = sg1(W[I-2]) + W[I-7] + sg0(W[I-15]) + W[I-16];
 
-  uint32 *H=ctx->H;
   v[0]=H[0]; v[1]=H[1]; v[2]=H[2]; v[3]=H[3];
   v[4]=H[4]; v[5]=H[5]; v[6]=H[6]; v[7]=H[7];
 
@@ -87,6 +92,33 @@ static void sha256_transform(sha256_context *ctx)
 }
 
 
+static void sha256_transform_select(uint32 *H,const byte *Data);
+
+// Select the transform once instead of every block. Transform is called
+// tens of thousands times in PBKDF2 for every password.
+static std::atomic<void (*)(uint32 *H,const byte *Data)> sha256_transform_proc(sha256_transform_select);
+
+void sha256_transform_select(uint32 *H,const byte *Data)
+{
+  void (*Proc)(uint32 *H,const byte *Data)=sha256_transform_c;
+#ifdef USE_SHA_NI
+  // We also need SSSE3 for byte shuffling and SSE4.1 for blending.
+  const uint NI=CPU_SHA|CPU_SSSE3|CPU_SSE41;
+  if ((GetCPUFeatures() & NI)==NI)
+    Proc=sha256_transform_ni;
+#endif
+  sha256_transform_proc.store(Proc,std::memory_order_relaxed);
+  Proc(H,Data);
+}
+
+
+// Process a single 64 byte block, updating H hash state.
+void sha256_transform(uint32 *H,const byte *Data)
+{
+  sha256_transform_proc.load(std::memory_order_relaxed)(H,Data);
+}
+
+
 void sha256_process(sha256_context *ctx, const void *Data, size_t Size)
 {
   const byte *Src=(const byte *)Data;
@@ -105,7 +137,7 @@ void sha256_process(sha256_context *ctx, const void *Data, size_t Size)
     if (BufPos == 64)
     {
       BufPos = 0;
-      sha256_transform(ctx);
+      sha256_transform(ctx->H,ctx->Buffer);
     }
   }
 }
@@ -126,14 +158,14 @@ void sha256_done(sha256_context *ctx, byte *Digest)
       BufPos=0;
     }
     if (BufPos==0)
-      sha256_transform(ctx);
+      sha256_transform(ctx->H,ctx->Buffer);
     memset(ctx->Buffer+BufPos,0,56-BufPos);
   }
 
   RawPutBE4((uint32)(BitLength>>32), ctx->Buffer + 56);
   RawPutBE4((uint32)(BitLength), ctx->Buffer + 60);
 
-  sha256_transform(ctx);
+  sha256_transform(ctx->H,ctx->Buffer);
 
   RawPutBE4(ctx->H[0], Digest +  0);
   RawPutBE4(ctx->H[1], Digest +  4);
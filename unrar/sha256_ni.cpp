@@ -0,0 +1,65 @@
+// SHA-256 block transform using Intel SHA extensions. Included from
+// sha256.cpp, which also provides the K round constants table.
+// Callers must check CPU_SHA, CPU_SSSE3 and CPU_SSE41 features.
+
+
+// Every step performs 4 rounds. Message words for steps 4..15 are calculated
+// from 4 previous message vectors stored in M0..M3 in cyclic order.
+#define SHA_NI_STEP(I,Msg) \
+  { \
+    __m128i W=_mm_add_epi32(Msg,_mm_loadu_si128((const __m128i *)(K+(I)*4))); \
+    State1=_mm_sha256rnds2_epu32(State1,State0,W); \
+    W=_mm_shuffle_epi32(W,0x0e); \
+    State0=_mm_sha256rnds2_epu32(State0,State1,W); \
+  }
+
+#define SHA_NI_SCHEDULE(M0,M1,M2,M3) \
+  { \
+    __m128i T=_mm_sha256msg1_epu32(M0,M1); \
+    T=_mm_add_epi32(T,_mm_alignr_epi8(M3,M2,4)); \
+    M0=_mm_sha256msg2_epu32(T,M3); \
+  }
+
+
+SSE_TARGET("sha,ssse3,sse4.1") static void sha256_transform_ni(uint32 *H,const byte *Data)
+{
+  const __m128i Mask=_mm_set_epi64x(0x0c0d0e0f08090a0bULL,0x0405060700010203ULL);
+
+  // Convert ABCD and EFGH state words to ABEF and CDGH order
+  // expected by sha256rnds2 instruction.
+  __m128i T=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(H+0)),0xb1);
+  __m128i State1=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(H+4)),0x1b);
+  __m128i State0=_mm_alignr_epi8(T,State1,8);
+  State1=_mm_blend_epi16(State1,T,0xf0);
+
+  __m128i SaveState0=State0,SaveState1=State1;
+
+  __m128i M0=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data+0)),Mask);
+  __m128i M1=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data+16)),Mask);
+  __m128i M2=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data+32)),Mask);
+  __m128i M3=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data+48)),Mask);
+
+  SHA_NI_STEP(0,M0);
+  SHA_NI_STEP(1,M1);
+  SHA_NI_STEP(2,M2);
+  SHA_NI_STEP(3,M3);
+  for (uint I=4;I<16;I+=4)
+  {
+    SHA_NI_SCHEDULE(M0,M1,M2,M3); SHA_NI_STEP(I+0,M0);
+    SHA_NI_SCHEDULE(M1,M2,M3,M0); SHA_NI_STEP(I+1,M1);
+    SHA_NI_SCHEDULE(M2,M3,M0,M1); SHA_NI_STEP(I+2,M2);
+    SHA_NI_SCHEDULE(M3,M0,M1,M2); SHA_NI_STEP(I+3,M3);
+  }
+
+  State0=_mm_add_epi32(State0,SaveState0);
+  State1=_mm_add_epi32(State1,SaveState1);
+
+  // Convert ABEF and CDGH back to ABCD and EFGH.
+  T=_mm_shuffle_epi32(State0,0x1b);
+  State1=_mm_shuffle_epi32(State1,0xb1);
+  _mm_storeu_si128((__m128i *)(H+0),_mm_blend_epi16(T,State1,0xf0));
+  _mm_storeu_si128((__m128i *)(H+4),_mm_alignr_epi8(State1,T,8));
+}
+
+#undef SHA_NI_STEP
+#undef SHA_NI_SCHEDULE
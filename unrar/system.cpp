@@ -160,23 +160,338 @@ bool IsUserAdmin()
 
 
 #ifdef USE_SSE
-SSE_VERSION _SSE_Version=GetSSEVersion();
-
-SSE_VERSION GetSSEVersion()
-{
-  int CPUInfo[4];
-  __cpuid(CPUInfo, 7);
-  if ((CPUInfo[1] & 0x20)!=0)
-    return SSE_AVX2;
-  __cpuid(CPUInfo, 1);
-  if ((CPUInfo[2] & 0x80000)!=0)
-    return SSE_SSE41;
-  if ((CPUInfo[2] & 0x200)!=0)
-    return SSE_SSSE3;
-  if ((CPUInfo[3] & 0x4000000)!=0)
-    return SSE_SSE2;
-  if ((CPUInfo[3] & 0x2000000)!=0)
-    return SSE_SSE;
-  return SSE_NONE;
+#ifndef _MSC_VER
+#include <cpuid.h>
+#endif
+
+static void CPUId(uint Leaf,uint *Regs)
+{
+#ifdef _MSC_VER
+  __cpuidex((int *)Regs,Leaf,0);
+#else
+  __cpuid_count(Leaf,0,Regs[0],Regs[1],Regs[2],Regs[3]);
+#endif
+}
+
+
+static uint DetectCPUFeatures()
+{
+  uint Regs[4];
+  CPUId(0,Regs);
+  uint MaxLeaf=Regs[0];
+  if (MaxLeaf<1)
+    return 0;
+
+  uint Features=0;
+  CPUId(1,Regs);
+  if ((Regs[3] & 0x2000000)!=0)
+    Features|=CPU_SSE;
+  if ((Regs[3] & 0x4000000)!=0)
+    Features|=CPU_SSE2;
+  if ((Regs[2] & 0x200)!=0)
+    Features|=CPU_SSSE3;
+  if ((Regs[2] & 0x80000)!=0)
+    Features|=CPU_SSE41;
+  if ((Regs[2] & 0x2000000)!=0)
+    Features|=CPU_AES;
+  if ((Regs[2] & 0x2)!=0)
+    Features|=CPU_PCLMUL;
+
+  // AVX2 also requires OS support for saving YMM registers.
+  bool AVX=(Regs[2] & 0x18000000)==0x18000000; // OSXSAVE and AVX.
+  if (AVX)
+  {
+#if defined(_MSC_VER) && _MSC_FULL_VER>=160040219
+    AVX=(_xgetbv(0) & 6)==6;
+#elif defined(_MSC_VER)
+    AVX=false; // No _xgetbv in older compilers.
+#else
+    uint XCR0,XCR0High;
+    __asm__ __volatile__ ("xgetbv" : "=a" (XCR0), "=d" (XCR0High) : "c" (0));
+    AVX=(XCR0 & 6)==6;
+#endif
+  }
+
+  if (MaxLeaf>=7)
+  {
+    CPUId(7,Regs);
+    if (AVX && (Regs[1] & 0x20)!=0)
+      Features|=CPU_AVX2;
+    if ((Regs[1] & 0x20000000)!=0)
+      Features|=CPU_SHA;
+  }
+  return Features;
+}
+
+
+// Apply RAR_CPU_FEATURES environment variable restrictions.
+static uint FilterCPUFeatures(uint Features)
+{
+  const char *EnvStr=getenv("RAR_CPU_FEATURES");
+  if (EnvStr==NULL)
+    return Features;
+
+  static const struct {const char *Name;uint Flag;} Names[]={
+    {"sse",CPU_SSE},{"sse2",CPU_SSE2},{"ssse3",CPU_SSSE3},{"sse41",CPU_SSE41},
+    {"avx2",CPU_AVX2},{"aes",CPU_AES},{"pclmul",CPU_PCLMUL},{"sha",CPU_SHA}
+  };
+  uint Allowed=0;
+  while (*EnvStr!=0)
+  {
+    char Name[16];
+    size_t Length=strcspn(EnvStr,",");
+    strncpyz(Name,EnvStr,Min(Length+1,ASIZE(Name)));
+    for (uint I=0;I<ASIZE(Names);I++)
+      if (stricomp(Name,Names[I].Name)==0)
+        Allowed|=Names[I].Flag;
+    EnvStr+=Length;
+    if (*EnvStr==',')
+      EnvStr++;
+  }
+  return Features & Allowed;
+}
+#endif
+
+
+// Set to CPU_DETECTED ored with features after detection. We use a zero
+// initialized variable instead of static initialization, so this function
+// can be safely called from other static initializers.
+static std::atomic<uint> CPUFeatures(0);
+static const uint CPU_DETECTED=0x80000000;
+
+uint GetCPUFeatures()
+{
+  uint Features=CPUFeatures.load(std::memory_order_relaxed);
+  if (Features==0)
+  {
+#ifdef USE_SSE
+    Features=FilterCPUFeatures(DetectCPUFeatures());
+#endif
+    // All threads detect the same value, so concurrent calls are harmless.
+    Features|=CPU_DETECTED;
+    CPUFeatures.store(Features,std::memory_order_relaxed);
+  }
+  return Features & ~CPU_DETECTED;
+}
+
+
+// Buffers of this size and larger are allocated page aligned directly
+// from OS. It is the typical x86 and ARM large page size.
+static const size_t LargePageSize=0x200000;
+
+// LARGE_PAGES_MODE+1 or 0 if not initialized yet. Atomic, because
+// SetLargePages can be called while decoder threads allocate windows.
+static std::atomic<uint> LargePagesMode(0);
+
+void SetLargePages(LARGE_PAGES_MODE Mode)
+{
+  LargePagesMode.store(Mode+1,std::memory_order_relaxed);
+}
+
+
+LARGE_PAGES_MODE GetLargePages()
+{
+  uint StoredMode=LargePagesMode.load(std::memory_order_relaxed);
+  if (StoredMode==0)
+  {
+    LARGE_PAGES_MODE Mode=LARGE_PAGES_ADVISE;
+    const char *EnvStr=getenv("RAR_LARGE_PAGES");
+    if (EnvStr!=NULL)
+    {
+      if (stricomp(EnvStr,"off")==0)
+        Mode=LARGE_PAGES_OFF;
+      else
+        if (stricomp(EnvStr,"explicit")==0)
+          Mode=LARGE_PAGES_EXPLICIT;
+    }
+    // Do not override the mode set by SetLargePages meanwhile.
+    StoredMode=Mode+1;
+    uint Expected=0;
+    if (!LargePagesMode.compare_exchange_strong(Expected,StoredMode,std::memory_order_relaxed))
+      StoredMode=Expected;
+  }
+  return (LARGE_PAGES_MODE)(StoredMode-1);
+}
+
+
+#ifdef _WIN_ALL
+// Return the minimum large page size or 0 if large pages are not available.
+// Large pages require "Lock pages in memory" privilege, so we try to enable
+// it first. GetLargePageMinimum is missing in Windows XP.
+static size_t GetLargePageMin()
+{
+  static std::atomic<size_t> PageMin((size_t)-1);
+  if (PageMin.load(std::memory_order_relaxed)==(size_t)-1)
+  {
+    size_t Min=0;
+    typedef SIZE_T (WINAPI *GETLARGEPAGEMINIMUM)();
+    GETLARGEPAGEMINIMUM pGetLargePageMinimum=(GETLARGEPAGEMINIMUM)
+      GetProcAddress(GetModuleHandleW(L"kernel32.dll"),"GetLargePageMinimum");
+    HANDLE hToken;
+    if (pGetLargePageMinimum!=NULL &&
+        OpenProcessToken(GetCurrentProcess(),TOKEN_ADJUST_PRIVILEGES|TOKEN_QUERY,&hToken))
+    {
+      TOKEN_PRIVILEGES tkp;
+      tkp.PrivilegeCount=1;
+      tkp.Privileges[0].Attributes=SE_PRIVILEGE_ENABLED;
+      if (LookupPrivilegeValue(NULL,SE_LOCK_MEMORY_NAME,&tkp.Privileges[0].Luid) &&
+          AdjustTokenPrivileges(hToken,FALSE,&tkp,0,NULL,NULL) &&
+          GetLastError()==ERROR_SUCCESS)
+        Min=pGetLargePageMinimum();
+      CloseHandle(hToken);
+    }
+    PageMin.store(Min,std::memory_order_relaxed);
+  }
+  return PageMin.load(std::memory_order_relaxed);
+}
+#endif
+
+
+void* LargeAlloc(size_t Size)
+{
+  if (Size<LargePageSize)
+    return malloc(Size);
+#ifdef _WIN_ALL
+  if (GetLargePages()==LARGE_PAGES_EXPLICIT)
+  {
+    size_t PageMin=GetLargePageMin();
+    if (PageMin!=0)
+    {
+      size_t AllocSize=(Size+PageMin-1)/PageMin*PageMin;
+      void *Mem=VirtualAlloc(NULL,AllocSize,MEM_COMMIT|MEM_RESERVE|MEM_LARGE_PAGES,PAGE_READWRITE);
+      if (Mem!=NULL)
+        return Mem;
+    }
+  }
+  // Windows does not provide transparent large pages.
+  return VirtualAlloc(NULL,Size,MEM_COMMIT|MEM_RESERVE,PAGE_READWRITE);
+#elif defined(_UNIX)
+  LARGE_PAGES_MODE Mode=GetLargePages();
+  size_t AllocSize=(Size+LargePageSize-1)&~(LargePageSize-1);
+#ifdef MAP_HUGETLB
+  if (Mode==LARGE_PAGES_EXPLICIT)
+  {
+    // Fails if there are no enough reserved huge pages in the system.
+    void *Mem=mmap(NULL,AllocSize,PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+    if (Mem!=MAP_FAILED)
+      return Mem;
+  }
+#endif
+  // Map one extra page to align the buffer to large page boundary,
+  // so transparent huge pages can cover it completely.
+  size_t MapSize=AllocSize+LargePageSize;
+  byte *Map=(byte *)mmap(NULL,MapSize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  if (Map==(byte *)MAP_FAILED)
+    return NULL;
+  byte *Mem=(byte *)(((size_t)Map+LargePageSize-1)&~(LargePageSize-1));
+  if (Mem>Map)
+    munmap(Map,Mem-Map);
+  if (Map+MapSize>Mem+AllocSize)
+    munmap(Mem+AllocSize,Map+MapSize-(Mem+AllocSize));
+#ifdef MADV_HUGEPAGE
+  // Also disable huge pages in "off" mode if they are enabled system-wide,
+  // so both modes can be compared.
+  madvise(Mem,AllocSize,Mode==LARGE_PAGES_OFF ? MADV_NOHUGEPAGE:MADV_HUGEPAGE);
+#endif
+  return Mem;
+#else
+  return malloc(Size);
+#endif
+}
+
+
+void LargeFree(void *Mem,size_t Size)
+{
+  if (Mem==NULL)
+    return;
+  if (Size<LargePageSize)
+  {
+    free(Mem);
+    return;
+  }
+#ifdef _WIN_ALL
+  VirtualFree(Mem,0,MEM_RELEASE);
+#elif defined(_UNIX)
+  munmap(Mem,(Size+LargePageSize-1)&~(LargePageSize-1));
+#else
+  free(Mem);
+#endif
 }
+
+
+void* MappedAlloc(size_t Size)
+{
+  if (Size==0)
+    return NULL;
+#ifdef _WIN_ALL
+  wchar TempPath[NM],TempName[NM];
+  if (GetTempPathW(ASIZE(TempPath),TempPath)==0 ||
+      GetTempFileNameW(TempPath,L"rar",0,TempName)==0)
+    return NULL;
+  HANDLE hFile=CreateFileW(TempName,GENERIC_READ|GENERIC_WRITE,0,NULL,CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE,NULL);
+  if (hFile==INVALID_HANDLE_VALUE)
+  {
+    DeleteFileW(TempName);
+    return NULL;
+  }
+  void *Mem=NULL;
+  HANDLE hMap=CreateFileMappingW(hFile,NULL,PAGE_READWRITE,
+                                 (DWORD)((uint64)Size>>32),(DWORD)Size,NULL);
+  if (hMap!=NULL)
+  {
+    Mem=MapViewOfFile(hMap,FILE_MAP_WRITE,0,0,Size);
+    CloseHandle(hMap);
+  }
+  // The view keeps the file open, it is deleted when the view is unmapped.
+  CloseHandle(hFile);
+  return Mem;
+#elif defined(_UNIX)
+  char TempName[NM];
+  const char *TempDir=getenv("TMPDIR");
+  strncpyz(TempName,TempDir!=NULL && *TempDir!=0 ? TempDir:"/tmp",ASIZE(TempName));
+  strncatz(TempName,"/rarXXXXXX",ASIZE(TempName));
+  int fd=mkstemp(TempName);
+  if (fd!=-1)
+    unlink(TempName);
+#ifdef MFD_CLOEXEC
+  else
+    fd=memfd_create("rar",MFD_CLOEXEC); // No writable temporary folder.
 #endif
+  if (fd==-1)
+    return NULL;
+#ifdef __APPLE__
+  bool Sized=ftruncate(fd,(off_t)Size)==0;
+#else
+  // Reserve disk space now. Writing to a sparse file mapping would raise
+  // SIGBUS if disk is full.
+  bool Sized=posix_fallocate(fd,0,(off_t)Size)==0;
+#endif
+  void *Mem=NULL;
+  if (Sized)
+  {
+    Mem=mmap(NULL,Size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    if (Mem==MAP_FAILED)
+      Mem=NULL;
+  }
+  close(fd);
+  return Mem;
+#else
+  return malloc(Size);
+#endif
+}
+
+
+void MappedFree(void *Mem,size_t Size)
+{
+  if (Mem==NULL)
+    return;
+#ifdef _WIN_ALL
+  UnmapViewOfFile(Mem);
+#elif defined(_UNIX)
+  munmap(Mem,Size);
+#else
+  free(Mem);
+#endif
+}
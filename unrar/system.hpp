@@ -30,10 +30,42 @@ bool IsUserAdmin();
 #endif
 
 
-#ifdef USE_SSE
-enum SSE_VERSION {SSE_NONE,SSE_SSE,SSE_SSE2,SSE_SSSE3,SSE_SSE41,SSE_AVX2};
-SSE_VERSION GetSSEVersion();
-extern SSE_VERSION _SSE_Version;
-#endif
+// CPU features used to select SIMD code at run time.
+enum CPU_FEATURES {
+  CPU_SSE=1,CPU_SSE2=2,CPU_SSSE3=4,CPU_SSE41=8,CPU_AVX2=0x10,
+  CPU_AES=0x20,CPU_PCLMUL=0x40,CPU_SHA=0x80
+};
+
+// Return CPU_FEATURES flags supported by both CPU and OS. Detected once.
+// RAR_CPU_FEATURES environment variable can contain a comma separated list
+// of allowed features, such as "sse2,ssse3", or "none" to force the baseline
+// code. It is useful to compare different code paths.
+uint GetCPUFeatures();
+
+
+// Page size modes for large buffers allocated by LargeAlloc.
+enum LARGE_PAGES_MODE {
+  LARGE_PAGES_OFF,      // Normal pages only.
+  LARGE_PAGES_ADVISE,   // Transparent huge pages, if supported by OS.
+  LARGE_PAGES_EXPLICIT  // Reserved huge pages or Windows large pages.
+};
+
+// Default is LARGE_PAGES_ADVISE. RAR_LARGE_PAGES environment variable can
+// set "off", "advise" or "explicit" mode, SetLargePages overrides both.
+// Modes not supported by OS or system settings fall back to normal pages.
+void SetLargePages(LARGE_PAGES_MODE Mode);
+LARGE_PAGES_MODE GetLargePages();
+
+// Allocate buffers like dictionary windows, which are large enough to
+// benefit from large pages. Smaller buffers are allocated with malloc.
+// Size passed to LargeFree must be the same as passed to LargeAlloc.
+void* LargeAlloc(size_t Size);
+void LargeFree(void *Mem,size_t Size);
+
+// Allocate memory in a deleted temporary file mapped to address space.
+// Unlike heap, it can be written back to disk under memory pressure even
+// without swap. Returns NULL if temporary file cannot be created.
+void* MappedAlloc(size_t Size);
+void MappedFree(void *Mem,size_t Size);
 
 #endif
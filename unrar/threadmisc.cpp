@@ -1,46 +1,59 @@
-// Typically we use the same global thread pool for all RAR modules.
-static ThreadPool *GlobalPool=NULL;
-static uint GlobalPoolUseCount=0;
+// We use the same global scheduler and worker threads for all RAR modules
+// and all archives opened in the process.
+static TaskScheduler *GlobalScheduler=NULL;
+static uint GlobalSchedulerUseCount=0;
 
-static inline bool CriticalSectionCreate(CRITSECT_HANDLE *CritSection)
+// Number of scheduler worker threads set by user, 0 for default.
+static uint PoolThreads=0;
+
+// Hint for CPU that we are in spin-wait loop.
+static inline void CpuPause()
 {
-#ifdef _WIN_ALL
-  InitializeCriticalSection(CritSection);
-  return true;
-#elif defined(_UNIX)
-  return pthread_mutex_init(CritSection,NULL)==0;
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+  _mm_pause();
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+  __builtin_ia32_pause();
 #endif
 }
 
 
-static inline void CriticalSectionDelete(CRITSECT_HANDLE *CritSection)
+#ifdef _UNIX
+#ifdef __linux__
+// Sleep while *Addr is equal to Value. It can return earlier, so callers
+// must check the waited condition in loop.
+static inline void AddrWait(std::atomic<uint> *Addr,uint Value)
 {
-#ifdef _WIN_ALL
-  DeleteCriticalSection(CritSection);
-#elif defined(_UNIX)
-  pthread_mutex_destroy(CritSection);
-#endif
+  syscall(SYS_futex,(uint *)Addr,FUTEX_WAIT_PRIVATE,Value,NULL,NULL,0);
 }
 
 
-static inline void CriticalSectionStart(CRITSECT_HANDLE *CritSection)
+static inline void AddrWake(std::atomic<uint> *Addr,uint Count)
 {
-#ifdef _WIN_ALL
-  EnterCriticalSection(CritSection);
-#elif defined(_UNIX)
-  pthread_mutex_lock(CritSection);
-#endif
+  syscall(SYS_futex,(uint *)Addr,FUTEX_WAKE_PRIVATE,Count,NULL,NULL,0);
+}
+#else
+// Other Unix systems do not provide futexes, so we use the single
+// condition variable for all waiting threads.
+static pthread_mutex_t AddrWaitMutex=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t AddrWaitCond=PTHREAD_COND_INITIALIZER;
+
+static inline void AddrWait(std::atomic<uint> *Addr,uint Value)
+{
+  pthread_mutex_lock(&AddrWaitMutex);
+  if (Addr->load()==Value)
+    pthread_cond_wait(&AddrWaitCond,&AddrWaitMutex);
+  pthread_mutex_unlock(&AddrWaitMutex);
 }
 
 
-static inline void CriticalSectionEnd(CRITSECT_HANDLE *CritSection)
+static inline void AddrWake(std::atomic<uint> *Addr,uint Count)
 {
-#ifdef _WIN_ALL
-  LeaveCriticalSection(CritSection);
-#elif defined(_UNIX)
-  pthread_mutex_unlock(CritSection);
-#endif
+  pthread_mutex_lock(&AddrWaitMutex);
+  pthread_cond_broadcast(&AddrWaitCond);
+  pthread_mutex_unlock(&AddrWaitMutex);
 }
+#endif
+#endif
 
 
 static struct GlobalPoolCreateSync
@@ -55,23 +68,18 @@ ThreadPool* CreateThreadPool()
 {
   CriticalSectionStart(&PoolCreateSync.CritSection); 
 
-  if (GlobalPoolUseCount++ == 0)
-    GlobalPool=new ThreadPool(MaxPoolThreads);
+  // Scheduler threads are created only when the first task is added,
+  // so objects, which never add tasks, do not start any threads.
+  if (GlobalSchedulerUseCount++ == 0)
+    GlobalScheduler=new TaskScheduler(GetPoolThreads());
 
-  // We use a simple thread pool, which does not allow to add tasks from
-  // different functions and threads in the same time. It is ok for RAR,
-  // but UnRAR.dll can be used in multithreaded environment. So if one of
-  // threads requests a copy of global pool and another copy is already
-  // in use, we create and return a new pool instead of existing global.
-  if (GlobalPoolUseCount > 1)
-  {
-    ThreadPool *Pool = new ThreadPool(MaxPoolThreads);
-    CriticalSectionEnd(&PoolCreateSync.CritSection); 
-    return Pool;
-  }
+  // ThreadPool objects are lightweight task groups with own WaitDone,
+  // so different threads can use different objects in the same time
+  // sharing the same workers.
+  ThreadPool *Pool=new ThreadPool(GlobalScheduler);
 
   CriticalSectionEnd(&PoolCreateSync.CritSection); 
-  return GlobalPool;
+  return Pool;
 }
 
 
@@ -79,21 +87,36 @@ void DestroyThreadPool(ThreadPool *Pool)
 {
   if (Pool!=NULL)
   {
-    CriticalSectionStart(&PoolCreateSync.CritSection); 
+    // Wait for pool tasks before deleting the scheduler.
+    delete Pool;
 
-    if (GlobalPoolUseCount > 0 && --GlobalPoolUseCount == 0 && Pool==GlobalPool)
-      delete GlobalPool;
+    CriticalSectionStart(&PoolCreateSync.CritSection); 
 
-    // To correctly work in multithreaded environment UnRAR.dll creates
-    // new pools if global pool is already in use. We delete such pools here.
-    if (Pool!=GlobalPool)
-      delete Pool;
+    if (GlobalSchedulerUseCount > 0 && --GlobalSchedulerUseCount == 0)
+    {
+      delete GlobalScheduler;
+      GlobalScheduler=NULL;
+    }
 
     CriticalSectionEnd(&PoolCreateSync.CritSection); 
   }
 }
 
 
+void SetPoolThreads(uint Threads)
+{
+  CriticalSectionStart(&PoolCreateSync.CritSection); 
+  PoolThreads=Min(Threads,MaxPoolThreads);
+  CriticalSectionEnd(&PoolCreateSync.CritSection); 
+}
+
+
+uint GetPoolThreads()
+{
+  return PoolThreads==0 ? GetNumberOfThreads() : PoolThreads;
+}
+
+
 static THREAD_HANDLE ThreadCreate(NATIVE_THREAD_PTR Proc,void *Data)
 {
 #ifdef _UNIX
@@ -150,19 +173,6 @@ static void CWaitForSingleObject(HANDLE hHandle)
 #endif
 
 
-#ifdef _UNIX
-static void cpthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
-{
-  int rc=pthread_cond_wait(cond,mutex);
-  if (rc!=0)
-  {
-    ErrHandler.GeneralErrMsg(L"\npthread_cond_wait error %d",rc);
-    ErrHandler.Exit(RARX_FATAL);
-  }
-}
-#endif
-
-
 uint GetNumberOfCPU()
 {
 #ifndef RAR_SMP
@@ -7,7 +7,86 @@
 int ThreadPool::ThreadPriority=THREAD_PRIORITY_NORMAL;
 #endif
 
-ThreadPool::ThreadPool(uint MaxThreads)
+// Number of spin iterations before idle worker or WaitDone go to sleep.
+// Small RAR5 blocks and BLAKE2 chunks are processed faster than
+// the sleep and wake system call pair, so it is better to spin a little.
+static const uint PoolSpinCount=2000;
+
+
+void TaskScheduler::TaskQueue::Init()
+{
+  Cells=new Cell[QueueSize];
+  for (uint I=0;I<QueueSize;I++)
+    Cells[I].Seq.store(I,std::memory_order_relaxed);
+  PushPos.store(0,std::memory_order_relaxed);
+  PopPos.store(0,std::memory_order_relaxed);
+}
+
+
+// Return false if queue is full.
+bool TaskScheduler::TaskQueue::Push(QueueEntry *Entry)
+{
+  uint Pos=PushPos.load(std::memory_order_relaxed);
+  Cell *C;
+  while (true)
+  {
+    C=Cells+(Pos & (QueueSize-1));
+    int Diff=int(C->Seq.load(std::memory_order_acquire)-Pos);
+    if (Diff==0)
+    {
+      if (PushPos.compare_exchange_weak(Pos,Pos+1,std::memory_order_relaxed))
+        break;
+    }
+    else
+      if (Diff<0)
+        return false;
+      else
+        Pos=PushPos.load(std::memory_order_relaxed);
+  }
+  C->Entry=*Entry;
+  C->Owner.store(Entry->Pool,std::memory_order_relaxed);
+  C->Seq.store(Pos+1,std::memory_order_release);
+  return true;
+}
+
+
+// Return false if queue is empty. If Owner is not NULL, return false also
+// if the first queued task belongs to another ThreadPool object.
+bool TaskScheduler::TaskQueue::Pop(QueueEntry *Entry,ThreadPool *Owner)
+{
+  uint Pos=PopPos.load(std::memory_order_relaxed);
+  Cell *C;
+  while (true)
+  {
+    C=Cells+(Pos & (QueueSize-1));
+    int Diff=int(C->Seq.load(std::memory_order_acquire)-(Pos+1));
+    if (Diff==0)
+    {
+      if (Owner!=NULL && C->Owner.load(std::memory_order_relaxed)!=Owner)
+      {
+        // Owner could be changed by other consumer and producer after our
+        // Seq check, so report a foreign task only if position is current.
+        if (PopPos.load(std::memory_order_relaxed)==Pos)
+          return false;
+        Pos=PopPos.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (PopPos.compare_exchange_weak(Pos,Pos+1,std::memory_order_relaxed))
+        break;
+    }
+    else
+      if (Diff<0)
+        return false;
+      else
+        Pos=PopPos.load(std::memory_order_relaxed);
+  }
+  *Entry=C->Entry;
+  C->Seq.store(Pos+QueueSize,std::memory_order_release);
+  return true;
+}
+
+
+TaskScheduler::TaskScheduler(uint MaxThreads)
 {
   MaxAllowedThreads = MaxThreads;
   if (MaxAllowedThreads>MaxPoolThreads)
@@ -16,55 +95,40 @@ ThreadPool::ThreadPool(uint MaxThreads)
     MaxAllowedThreads=1;
 
   ThreadsCreatedCount=0;
-
-  // If we have more threads than queue size, we'll hang on pool destroying,
-  // not releasing all waiting threads.
-  if (MaxAllowedThreads>ASIZE(TaskQueue))
-    MaxAllowedThreads=ASIZE(TaskQueue);
+  ThreadsCreated=false;
 
   Closing=false;
+  Sleepers=0;
+  SpinCount=GetNumberOfCPU()>1 ? PoolSpinCount:0;
+
+  for (uint I=0;I<MaxAllowedThreads;I++)
+    Queues[I].Init();
+
+  Overflow=NULL;
+  OverflowAllocated=0;
+  OverflowCount=0;
 
   bool Success = CriticalSectionCreate(&CritSection);
 #ifdef _WIN_ALL
-  QueuedTasksCnt=CreateSemaphore(NULL,0,ASIZE(TaskQueue),NULL);
-  NoneActive=CreateEvent(NULL,TRUE,TRUE,NULL);
-  Success=Success && QueuedTasksCnt!=NULL && NoneActive!=NULL;
-#elif defined(_UNIX)
-  AnyActive = false;
-  QueuedTasksCnt = 0;
-  Success=Success && pthread_cond_init(&AnyActiveCond,NULL)==0 &&
-          pthread_mutex_init(&AnyActiveMutex,NULL)==0 &&
-          pthread_cond_init(&QueuedTasksCntCond,NULL)==0 &&
-          pthread_mutex_init(&QueuedTasksCntMutex,NULL)==0;
+  WakeSem=CreateSemaphore(NULL,0,0x7fffffff,NULL);
+  Success=Success && WakeSem!=NULL;
+#else
+  WakeEpoch=0;
 #endif
   if (!Success)
   {
     ErrHandler.GeneralErrMsg(L"\nThread pool initialization failed.");
     ErrHandler.Exit(RARX_FATAL);
   }
-
-  QueueTop = 0;
-  QueueBottom = 0;
-  ActiveThreads = 0;
 }
 
 
-ThreadPool::~ThreadPool()
+TaskScheduler::~TaskScheduler()
 {
-  WaitDone();
+  // All ThreadPool objects are already destroyed here and they wait for
+  // their tasks, so queues are empty.
   Closing=true;
-
-#ifdef _WIN_ALL
-  ReleaseSemaphore(QueuedTasksCnt,ASIZE(TaskQueue),NULL);
-#elif defined(_UNIX)
-  // Threads still can access QueuedTasksCnt for a short time after WaitDone(),
-  // so lock is required. We would occassionally hang without it.
-  pthread_mutex_lock(&QueuedTasksCntMutex);
-  QueuedTasksCnt+=ASIZE(TaskQueue);
-  pthread_mutex_unlock(&QueuedTasksCntMutex);
-
-  pthread_cond_broadcast(&QueuedTasksCntCond);
-#endif
+  WakeWorkers(ThreadsCreatedCount);
 
   for(uint I=0;I<ThreadsCreatedCount;I++)
   {
@@ -77,24 +141,23 @@ ThreadPool::~ThreadPool()
     ThreadClose(ThreadHandles[I]);
   }
 
+  for (uint I=0;I<MaxAllowedThreads;I++)
+    delete[] Queues[I].Cells;
+  free(Overflow);
   CriticalSectionDelete(&CritSection);
 #ifdef _WIN_ALL
-  CloseHandle(QueuedTasksCnt);
-  CloseHandle(NoneActive);
-#elif defined(_UNIX)
-  pthread_cond_destroy(&AnyActiveCond);
-  pthread_mutex_destroy(&AnyActiveMutex);
-  pthread_cond_destroy(&QueuedTasksCntCond);
-  pthread_mutex_destroy(&QueuedTasksCntMutex);
+  CloseHandle(WakeSem);
 #endif
 }
 
 
-void ThreadPool::CreateThreads()
+void TaskScheduler::CreateThreads()
 {
   for(uint I=0;I<MaxAllowedThreads;I++)
   {
-    ThreadHandles[I] = ThreadCreate(PoolThread, this);
+    Workers[I].Scheduler=this;
+    Workers[I].Worker=I;
+    ThreadHandles[I] = ThreadCreate(PoolThread, Workers+I);
     ThreadsCreatedCount++;
 #ifdef _WIN_ALL
     if (ThreadPool::ThreadPriority!=THREAD_PRIORITY_NORMAL)
@@ -104,111 +167,288 @@ void ThreadPool::CreateThreads()
 }
 
 
-NATIVE_THREAD_TYPE ThreadPool::PoolThread(void *Param)
+NATIVE_THREAD_TYPE TaskScheduler::PoolThread(void *Param)
 {
-  ((ThreadPool*)Param)->PoolThreadLoop();
+  WorkerData *Data=(WorkerData *)Param;
+  Data->Scheduler->PoolThreadLoop(Data->Worker);
   return 0;
 }
 
 
-void ThreadPool::PoolThreadLoop()
+void TaskScheduler::PoolThreadLoop(uint Worker)
 {
   QueueEntry Task;
-  while (GetQueuedTask(&Task))
+  uint Spin=0;
+  while (!Closing.load(std::memory_order_acquire))
   {
-    Task.Proc(Task.Param);
-    
-    CriticalSectionStart(&CritSection); 
-    if (--ActiveThreads == 0)
+    if (PopTask(Worker,&Task))
+    {
+      RunTask(&Task);
+      Spin=0;
+      continue;
+    }
+    if (Spin++<SpinCount)
+    {
+      CpuPause();
+      continue;
+    }
+
+    // Announce that we are going to sleep and check the queues once again.
+    // Producer adds a task first and then checks Sleepers, so either we see
+    // the task here or producer sees us and wakes.
+#ifndef _WIN_ALL
+    uint Epoch=WakeEpoch.load();
+#endif
+    Sleepers++;
+    if (PopTask(Worker,&Task))
+    {
+      Sleepers--;
+      RunTask(&Task);
+      Spin=0;
+      continue;
+    }
+    if (!Closing.load())
     {
 #ifdef _WIN_ALL
-      SetEvent(NoneActive);
-#elif defined(_UNIX)
-      pthread_mutex_lock(&AnyActiveMutex);
-      AnyActive=false;
-      pthread_cond_signal(&AnyActiveCond);
-      pthread_mutex_unlock(&AnyActiveMutex);
+      CWaitForSingleObject(WakeSem);
+#else
+      AddrWait(&WakeEpoch,Epoch);
 #endif
     }
-    CriticalSectionEnd(&CritSection); 
+    Sleepers--;
+    Spin=0;
   }
 }
 
 
-bool ThreadPool::GetQueuedTask(QueueEntry *Task)
+// Take a task from own queue or steal from other queues and finally
+// check the overflow list. Worker equal to MaxAllowedThreads means
+// a thread without own queue, which only steals. If Owner is not NULL,
+// take only tasks of this ThreadPool object from queue heads and
+// the overflow list.
+bool TaskScheduler::PopTask(uint Worker,QueueEntry *Task,ThreadPool *Owner)
 {
+  for (uint I=0;I<MaxAllowedThreads;I++)
+    if (Queues[(Worker+I) % MaxAllowedThreads].Pop(Task,Owner))
+      return true;
+  if (OverflowCount.load(std::memory_order_acquire)>0)
+  {
+    CriticalSectionStart(&CritSection);
+    uint Count=OverflowCount.load(std::memory_order_relaxed);
+    bool Found=false;
+    for (uint I=Count;I>0 && !Found;I--)
+      if (Owner==NULL || Overflow[I-1].Pool==Owner)
+      {
+        *Task=Overflow[I-1];
+        memmove(Overflow+I-1,Overflow+I,(Count-I)*sizeof(QueueEntry));
+        OverflowCount.store(Count-1,std::memory_order_relaxed);
+        Found=true;
+      }
+    CriticalSectionEnd(&CritSection);
+    return Found;
+  }
+  return false;
+}
+
+
+void TaskScheduler::RunTask(QueueEntry *Task)
+{
+  Task->Proc(Task->Param);
+  Task->Pool->TaskDone();
+}
+
+
+void TaskScheduler::WakeWorkers(uint Count)
+{
+  if (Count==0)
+    return;
 #ifdef _WIN_ALL
-  CWaitForSingleObject(QueuedTasksCnt);
-#elif defined(_UNIX)
-  pthread_mutex_lock(&QueuedTasksCntMutex);
-  while (QueuedTasksCnt==0)
-    cpthread_cond_wait(&QueuedTasksCntCond,&QueuedTasksCntMutex);
-  QueuedTasksCnt--;
-  pthread_mutex_unlock(&QueuedTasksCntMutex);
+  ReleaseSemaphore(WakeSem,Count,NULL);
+#else
+  WakeEpoch++;
+  AddrWake(&WakeEpoch,Count);
 #endif
+}
 
-  if (Closing)
-    return false;
 
-  CriticalSectionStart(&CritSection); 
+// Add Count tasks for consecutive DataSize sized items of Data array,
+// starting from the queue of specified worker. It can be called
+// from different threads for different ThreadPool objects.
+void TaskScheduler::AddTasks(ThreadPool *Pool,uint Worker,PTHREAD_PROC Proc,
+                             byte *Data,size_t DataSize,uint Count)
+{
+  if (!ThreadsCreated.load(std::memory_order_acquire))
+  {
+    CriticalSectionStart(&CritSection);
+    if (ThreadsCreatedCount == 0)
+      CreateThreads();
+    ThreadsCreated.store(true,std::memory_order_release);
+    CriticalSectionEnd(&CritSection);
+  }
+
+  for (uint I=0;I<Count;I++)
+  {
+    QueueEntry Entry;
+    Entry.Proc=Proc;
+    Entry.Param=Data+I*DataSize;
+    Entry.Pool=Pool;
+
+    bool Added=false;
+    for (uint J=0;J<MaxAllowedThreads && !Added;J++)
+      Added=Queues[(Worker+I+J) % MaxAllowedThreads].Push(&Entry);
+    if (!Added) // All queues are full.
+    {
+      CriticalSectionStart(&CritSection);
+      uint OCount=OverflowCount.load(std::memory_order_relaxed);
+      if (OCount==OverflowAllocated)
+      {
+        uint NewAllocated=OverflowAllocated==0 ? 64 : OverflowAllocated*2;
+        QueueEntry *NewOverflow=(QueueEntry *)realloc(Overflow,NewAllocated*sizeof(QueueEntry));
+        if (NewOverflow==NULL)
+          ErrHandler.MemoryError();
+        Overflow=NewOverflow;
+        OverflowAllocated=NewAllocated;
+      }
+      Overflow[OCount]=Entry;
+      OverflowCount.store(OCount+1,std::memory_order_release);
+      CriticalSectionEnd(&CritSection);
+    }
+  }
 
-  *Task = TaskQueue[QueueBottom];
-  QueueBottom = (QueueBottom + 1) % ASIZE(TaskQueue);
+  // Full barrier to not let Sleepers read to pass task stores above.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  uint Sleeping=Sleepers.load();
+  if (Sleeping>0)
+    WakeWorkers(Min(Sleeping,Count));
+}
 
-  CriticalSectionEnd(&CritSection); 
 
+// Run a single queued task of Owner in the caller thread if any is available.
+// Lets waiting threads to help workers instead of sleeping. Tasks of other
+// ThreadPool objects are left to workers, so a waiting thread is not delayed
+// by unrelated and possibly long tasks.
+bool TaskScheduler::RunQueuedTask(ThreadPool *Owner)
+{
+  QueueEntry Task;
+  if (!PopTask(MaxAllowedThreads,&Task,Owner))
+    return false;
+  RunTask(&Task);
   return true;
 }
 
 
-// Add task to queue. We assume that it is always called from main thread,
-// it allows to avoid any locks here. We process collected tasks only
-// when WaitDone is called.
+ThreadPool::ThreadPool(TaskScheduler *Scheduler)
+{
+  ThreadPool::Scheduler=Scheduler;
+  NextWorker=0;
+  PendingTasks=0;
+  Finishing=0;
+
+#ifdef _WIN_ALL
+  NoneActive=CreateEvent(NULL,TRUE,TRUE,NULL);
+  if (NoneActive==NULL)
+  {
+    ErrHandler.GeneralErrMsg(L"\nThread pool initialization failed.");
+    ErrHandler.Exit(RARX_FATAL);
+  }
+#else
+  Waiting=false;
+#endif
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  WaitDone();
+
+  // Worker can still be inside of TaskDone() for a short time after
+  // WaitDone(), so we wait until it leaves.
+  while (Finishing.load()!=0)
+    CpuPause();
+
+#ifdef _WIN_ALL
+  CloseHandle(NoneActive);
+#endif
+}
+
+
+void ThreadPool::TaskDone()
+{
+  Finishing++;
+  if (PendingTasks.fetch_sub(1)==1)
+  {
+#ifdef _WIN_ALL
+    SetEvent(NoneActive);
+#else
+    if (Waiting.load())
+      AddrWake(&PendingTasks,1);
+#endif
+  }
+  Finishing--;
+}
+
+
 void ThreadPool::AddTask(PTHREAD_PROC Proc,void *Data)
 {
-  if (ThreadsCreatedCount == 0)
-    CreateThreads();
-  
-  // If queue is full, wait until it is empty.
-  if ((QueueTop + 1) % ASIZE(TaskQueue) == QueueBottom)
-    WaitDone();
+  AddTasks(Proc,Data,0,1);
+}
+
+
+// Add tasks to the global scheduler. Unlike the previous pool design,
+// tasks can start immediately, so task data must be prepared before
+// the call.
+void ThreadPool::AddTasks(PTHREAD_PROC Proc,void *Data,size_t DataSize,uint Count)
+{
+  if (Count==0)
+    return;
+#ifdef _WIN_ALL
+  if (PendingTasks.fetch_add(Count)==0)
+  {
+    // Do not let a late SetEvent from previous tasks to follow our reset.
+    while (Finishing.load()!=0)
+      CpuPause();
+    ResetEvent(NoneActive);
+  }
+#else
+  PendingTasks+=Count;
+#endif
 
-  TaskQueue[QueueTop].Proc = Proc;
-  TaskQueue[QueueTop].Param = Data;
-  QueueTop = (QueueTop + 1) % ASIZE(TaskQueue);
+  Scheduler->AddTasks(this,NextWorker,Proc,(byte *)Data,DataSize,Count);
+  NextWorker+=Count;
 }
 
 
-// Start queued tasks and wait until all threads are inactive.
-// We assume that it is always called from main thread, when pool threads
-// are sleeping yet.
+// Wait until all tasks added to this object are completed. While waiting,
+// the caller thread executes queued tasks itself if workers are busy.
 void ThreadPool::WaitDone()
 {
-  // We add ASIZE(TaskQueue) for case if TaskQueue array size is not
-  // a power of two. Negative numbers would not suit our purpose here.
-  ActiveThreads=(QueueTop+ASIZE(TaskQueue)-QueueBottom) % ASIZE(TaskQueue);
-  if (ActiveThreads==0)
-    return;
+  uint Spin=0;
+  while (true)
+  {
+    uint Pending=PendingTasks.load();
+    if (Pending==0)
+      break;
+    if (Scheduler->RunQueuedTask(this))
+    {
+      Spin=0;
+      continue;
+    }
+    if (Spin++<Scheduler->GetSpinCount())
+    {
+      CpuPause();
+      continue;
+    }
 #ifdef _WIN_ALL
-  ResetEvent(NoneActive);
-  ReleaseSemaphore(QueuedTasksCnt,ActiveThreads,NULL);
-  CWaitForSingleObject(NoneActive);
-#elif defined(_UNIX)
-  AnyActive=true;
-
-  // Threads reset AnyActive before accessing QueuedTasksCnt and even
-  // preceding WaitDone() call does not guarantee that some slow thread
-  // is not accessing QueuedTasksCnt now. So lock is necessary.
-  pthread_mutex_lock(&QueuedTasksCntMutex);
-  QueuedTasksCnt+=ActiveThreads;
-  pthread_mutex_unlock(&QueuedTasksCntMutex);
-
-  pthread_cond_broadcast(&QueuedTasksCntCond);
-
-  pthread_mutex_lock(&AnyActiveMutex);
-  while (AnyActive)
-    cpthread_cond_wait(&AnyActiveCond,&AnyActiveMutex);
-  pthread_mutex_unlock(&AnyActiveMutex);
+    CWaitForSingleObject(NoneActive);
+#else
+    // TaskDone decrements PendingTasks first and then checks Waiting,
+    // so either we see the changed value or it sees our flag and wakes us.
+    Waiting.store(true);
+    Pending=PendingTasks.load();
+    if (Pending!=0)
+      AddrWait(&PendingTasks,Pending);
+    Waiting.store(false);
 #endif
+  }
 }
 #endif // RAR_SMP
@@ -10,7 +10,12 @@ const uint MaxPoolThreads=32;
 #ifdef _UNIX
   #include <pthread.h>
   #include <semaphore.h>
+  #ifdef __linux__
+    #include <sys/syscall.h>
+    #include <linux/futex.h>
+  #endif
 #endif
+#include <atomic>
 
 // Undefine for debugging.
 #define     USE_THREADS
@@ -27,69 +32,192 @@ const uint MaxPoolThreads=32;
   typedef CRITICAL_SECTION CRITSECT_HANDLE;
 #endif
 
+inline bool CriticalSectionCreate(CRITSECT_HANDLE *CritSection)
+{
+#ifdef _WIN_ALL
+  InitializeCriticalSection(CritSection);
+  return true;
+#elif defined(_UNIX)
+  return pthread_mutex_init(CritSection,NULL)==0;
+#endif
+}
+
+
+inline void CriticalSectionDelete(CRITSECT_HANDLE *CritSection)
+{
+#ifdef _WIN_ALL
+  DeleteCriticalSection(CritSection);
+#elif defined(_UNIX)
+  pthread_mutex_destroy(CritSection);
+#endif
+}
+
+
+inline void CriticalSectionStart(CRITSECT_HANDLE *CritSection)
+{
+#ifdef _WIN_ALL
+  EnterCriticalSection(CritSection);
+#elif defined(_UNIX)
+  pthread_mutex_lock(CritSection);
+#endif
+}
+
+
+inline void CriticalSectionEnd(CRITSECT_HANDLE *CritSection)
+{
+#ifdef _WIN_ALL
+  LeaveCriticalSection(CritSection);
+#elif defined(_UNIX)
+  pthread_mutex_unlock(CritSection);
+#endif
+}
+
+
 typedef void (*PTHREAD_PROC)(void *Data);
 #define THREAD_PROC(fn) void fn(void *Data)
 
 uint GetNumberOfCPU();
 uint GetNumberOfThreads();
 
+class ThreadPool;
 
-class ThreadPool
+// Process-wide set of worker threads shared by all ThreadPool objects,
+// so opening many archives does not multiply the number of threads.
+// Every worker has its own lock-free bounded task queue. Workers take
+// tasks from own queue first and steal from other queues when own is empty.
+// Tasks not fitting to full queues are stored to the unbounded overflow
+// list. Idle workers spin for a while before going to sleep.
+class TaskScheduler
 {
   private:
     struct QueueEntry
     {
-    	PTHREAD_PROC Proc;
+      PTHREAD_PROC Proc;
       void *Param;
+      ThreadPool *Pool; // Task owner to notify about task completion.
+    };
+
+    // Must be a power of 2.
+    static const uint QueueSize=256;
+
+    // Bounded multiple producer, multiple consumer queue. Every cell
+    // sequence number tells if the cell is ready for writing or reading
+    // on the current pass, so producers and consumers only need to
+    // reserve positions with compare and swap.
+    struct TaskQueue
+    {
+      struct Cell
+      {
+        std::atomic<uint> Seq;
+        QueueEntry Entry;
+
+        // Copy of Entry.Pool, which consumers can check before reserving
+        // the cell, when Entry can be overwritten by other threads.
+        std::atomic<ThreadPool *> Owner;
+      } *Cells;
+      std::atomic<uint> PushPos;
+      std::atomic<uint> PopPos;
+
+      void Init();
+      bool Push(QueueEntry *Entry);
+      bool Pop(QueueEntry *Entry,ThreadPool *Owner=NULL);
+    };
+
+    // Parameters passed to worker thread function.
+    struct WorkerData
+    {
+      TaskScheduler *Scheduler;
+      uint Worker;
     };
 
     void CreateThreads();
     static NATIVE_THREAD_TYPE PoolThread(void *Param);
-  	void PoolThreadLoop();
-  	bool GetQueuedTask(QueueEntry *Task);
+    void PoolThreadLoop(uint Worker);
+    bool PopTask(uint Worker,QueueEntry *Task,ThreadPool *Owner=NULL);
+    void RunTask(QueueEntry *Task);
+    void WakeWorkers(uint Count);
 
     // Number of threads in the pool. Must not exceed MaxPoolThreads.
     uint MaxAllowedThreads;
-  	THREAD_HANDLE ThreadHandles[MaxPoolThreads];
+    THREAD_HANDLE ThreadHandles[MaxPoolThreads];
+    WorkerData Workers[MaxPoolThreads];
 
     // Number of actually created threads.
     uint ThreadsCreatedCount;
+    std::atomic<bool> ThreadsCreated;
 
-    uint ActiveThreads;
+    TaskQueue Queues[MaxPoolThreads];
 
-  	QueueEntry TaskQueue[MaxPoolThreads];
-  	uint QueueTop;
-  	uint QueueBottom;
+    // Unbounded list for tasks exceeding capacity of all queues.
+    QueueEntry *Overflow;
+    uint OverflowAllocated;
+    std::atomic<uint> OverflowCount;
 
-    bool Closing; // Set true to quit all threads.
-  	
-#ifdef _WIN_ALL
-  	// Semaphore counting number of tasks stored in queue.
-  	HANDLE QueuedTasksCnt;
+    std::atomic<bool> Closing; // Set true to quit all threads.
 
-    // Event signalling if no active tasks are performing now.
-    HANDLE NoneActive;
+    // Number of idle spin iterations before going to sleep. Zero
+    // on single CPU systems, where spinning only delays other threads.
+    uint SpinCount;
 
-#elif defined(_UNIX)
-    // Semaphores seem to be slower than conditional variables in pthreads,
-    // so we use the conditional variable to count tasks stored in queue.
-    uint QueuedTasksCnt;
-    pthread_cond_t QueuedTasksCntCond;
-    pthread_mutex_t QueuedTasksCntMutex;
-
-    bool AnyActive; // Active tasks present flag.
-    pthread_cond_t AnyActiveCond;
-    pthread_mutex_t AnyActiveMutex;
+    // Number of workers going to sleep or sleeping.
+    std::atomic<uint> Sleepers;
+
+#ifdef _WIN_ALL
+    // Semaphore to wake sleeping workers.
+    HANDLE WakeSem;
+#else
+    // Incremented to wake sleeping workers, which wait for its change.
+    std::atomic<uint> WakeEpoch;
 #endif
 
-    // Pool critical section. We use the single section for all branches
-    // to avoid deadlocks, when thread1 has section1 and wants section2
-    // and thread2 has section2 and wants section1.
-  	CRITSECT_HANDLE CritSection;
+    // Protects lazy thread creation and overflow list.
+    CRITSECT_HANDLE CritSection;
+  public:
+    TaskScheduler(uint MaxThreads);
+    ~TaskScheduler();
+    void AddTasks(ThreadPool *Pool,uint Worker,PTHREAD_PROC Proc,
+                  byte *Data,size_t DataSize,uint Count);
+    bool RunQueuedTask(ThreadPool *Owner);
+    uint GetThreadCount() {return MaxAllowedThreads;}
+    uint GetSpinCount() {return SpinCount;}
+};
+
+
+// Group of tasks sharing the global scheduler. Objects are cheap and do not
+// own threads. Every object must be used by one producer thread at a time,
+// WaitDone waits only for tasks added to this object.
+class ThreadPool
+{
+  private:
+    friend class TaskScheduler;
+    void TaskDone();
+
+    TaskScheduler *Scheduler;
+
+    // Queue to place the next task to, so tasks are spread among workers.
+    uint NextWorker;
+
+    // Number of added and not completed yet tasks.
+    std::atomic<uint> PendingTasks;
+
+    // Number of workers still inside of TaskDone. We must not destroy
+    // the object until they leave it.
+    std::atomic<uint> Finishing;
+
+#ifdef _WIN_ALL
+    // Event signalling if no pending tasks are present.
+    HANDLE NoneActive;
+#else
+    std::atomic<bool> Waiting; // Owner sleeps in WaitDone.
+#endif
   public:
-    ThreadPool(uint MaxThreads);
+    ThreadPool(TaskScheduler *Scheduler);
     ~ThreadPool();
     void AddTask(PTHREAD_PROC Proc,void *Data);
+
+    // Add Count tasks for Count consecutive DataSize sized items of Data
+    // array, waking workers only once for the entire batch.
+    void AddTasks(PTHREAD_PROC Proc,void *Data,size_t DataSize,uint Count);
     void WaitDone();
 
 #ifdef _WIN_ALL
@@ -101,6 +229,12 @@ class ThreadPool
 ThreadPool* CreateThreadPool();
 void DestroyThreadPool(ThreadPool *Pool);
 
+// Number of worker threads in the global scheduler. Applied when
+// the scheduler is created, so typically it must be set before opening
+// archives. Zero means the number of threads suitable for current CPU.
+void SetPoolThreads(uint Threads);
+uint GetPoolThreads();
+
 #endif // RAR_SMP
 
 #endif // _RAR_THREADPOOL_
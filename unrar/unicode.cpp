@@ -252,10 +252,104 @@ wchar* RawToWide(const byte *Src,wchar *Dest,size_t DestSize)
 }
 
 
+#ifdef USE_SSE
+// Archived names are mostly ASCII, so we convert their ASCII part 16
+// characters per step and leave the rest including the terminating zero
+// to the generic code. We load only blocks before the terminating zero,
+// the string length limits the number of blocks.
+// Return the number of converted characters.
+static size_t AsciiToWide(const char *Src,wchar *Dest,size_t MaxSize)
+{
+  const size_t Step=16;
+  size_t Length=Min(strlen(Src),MaxSize);
+  size_t Size=0;
+  while (Size+Step<=Length)
+  {
+    __m128i Chars=_mm_loadu_si128((const __m128i *)(Src+Size));
+    // High bit is set for non-ASCII bytes.
+    if (_mm_movemask_epi8(Chars)!=0)
+      break;
+    __m128i Zero=_mm_setzero_si128();
+    __m128i Lo=_mm_unpacklo_epi8(Chars,Zero),Hi=_mm_unpackhi_epi8(Chars,Zero);
+    __m128i *D=(__m128i *)(Dest+Size);
+    if (sizeof(wchar)==2)
+    {
+      _mm_storeu_si128(D,Lo);
+      _mm_storeu_si128(D+1,Hi);
+    }
+    else
+    {
+      _mm_storeu_si128(D,_mm_unpacklo_epi16(Lo,Zero));
+      _mm_storeu_si128(D+1,_mm_unpackhi_epi16(Lo,Zero));
+      _mm_storeu_si128(D+2,_mm_unpacklo_epi16(Hi,Zero));
+      _mm_storeu_si128(D+3,_mm_unpackhi_epi16(Hi,Zero));
+    }
+    Size+=Step;
+  }
+  return Size;
+}
+
+
+// Load 16 wide characters as bytes. Return false if some of them
+// are not ASCII.
+static inline bool LoadWideAscii(const wchar *Src,__m128i *Chars)
+{
+  const __m128i Zero=_mm_setzero_si128();
+  const __m128i *S=(const __m128i *)Src;
+  __m128i Bad,Packed;
+  if (sizeof(wchar)==2)
+  {
+    const __m128i NonAscii=_mm_set1_epi16(~0x7f);
+    __m128i W1=_mm_loadu_si128(S),W2=_mm_loadu_si128(S+1);
+    Bad=_mm_and_si128(_mm_or_si128(W1,W2),NonAscii);
+    Packed=_mm_packus_epi16(W1,W2);
+  }
+  else
+  {
+    const __m128i NonAscii=_mm_set1_epi32(~0x7f);
+    __m128i W1=_mm_loadu_si128(S),W2=_mm_loadu_si128(S+1);
+    __m128i W3=_mm_loadu_si128(S+2),W4=_mm_loadu_si128(S+3);
+    __m128i Any=_mm_or_si128(_mm_or_si128(W1,W2),_mm_or_si128(W3,W4));
+    Bad=_mm_and_si128(Any,NonAscii);
+    Packed=_mm_packus_epi16(_mm_packs_epi32(W1,W2),_mm_packs_epi32(W3,W4));
+  }
+  *Chars=Packed;
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(Bad,Zero))==0xffff;
+}
+
+
+// Same as AsciiToWide in opposite direction.
+static size_t WideToAscii(const wchar *Src,char *Dest,size_t MaxSize)
+{
+  const size_t Step=16;
+  size_t Length=Min(wcslen(Src),MaxSize);
+  size_t Size=0;
+  while (Size+Step<=Length)
+  {
+    __m128i Chars;
+    if (!LoadWideAscii(Src+Size,&Chars))
+      break;
+    _mm_storeu_si128((__m128i *)(Dest+Size),Chars);
+    Size+=Step;
+  }
+  return Size;
+}
+#endif
+
+
 void WideToUtf(const wchar *Src,char *Dest,size_t DestSize)
 {
   long dsize=(long)DestSize;
   dsize--;
+#ifdef USE_SSE
+  if (dsize>0)
+  {
+    size_t Ascii=WideToAscii(Src,Dest,dsize);
+    Src+=Ascii;
+    Dest+=Ascii;
+    dsize-=(long)Ascii;
+  }
+#endif
   while (*Src!=0 && --dsize>=0)
   {
     uint c=*(Src++);
@@ -326,6 +420,15 @@ bool UtfToWide(const char *Src,wchar *Dest,size_t DestSize)
   bool Success=true;
   long dsize=(long)DestSize;
   dsize--;
+#ifdef USE_SSE
+  if (dsize>0)
+  {
+    size_t Ascii=AsciiToWide(Src,Dest,dsize);
+    Src+=Ascii;
+    Dest+=Ascii;
+    dsize-=(long)Ascii;
+  }
+#endif
   while (*Src!=0)
   {
     uint c=byte(*(Src++)),d;
@@ -540,6 +643,9 @@ int tolowerw(int ch)
 }
 
 
+#include "casefold.cpp"
+
+
 int atoiw(const wchar *s)
 {
   return (int)atoilw(s);
@@ -24,6 +24,7 @@ wchar* wcsupper(wchar *s);
 #endif
 int toupperw(int ch);
 int tolowerw(int ch);
+uint FoldCase(uint c);
 int atoiw(const wchar *s);
 int64 atoilw(const wchar *s);
 
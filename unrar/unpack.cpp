@@ -14,12 +14,17 @@
 #include "unpack30.cpp"
 #include "unpack50.cpp"
 #include "unpack50frag.cpp"
+#include "winpool.cpp"
 
 Unpack::Unpack(ComprDataIO *DataIO)
-:Inp(true),VMCodeInp(true)
+:Inp(true),VMCodeInp(false)
 {
   UnpIO=DataIO;
   Window=NULL;
+  // Tables and models of older formats are allocated on first use.
+  T15=NULL;
+  T20=NULL;
+  PPM=NULL;
   Fragmented=false;
   Suspended=false;
   UnpAllBuf=false;
@@ -28,19 +33,22 @@ Unpack::Unpack(ComprDataIO *DataIO)
   MaxUserThreads=1;
   UnpThreadPool=CreateThreadPool();
   ReadBufMT=NULL;
+  ReadBufMTSize=0;
   UnpThreadData=NULL;
+  UnpThreadDataCount=0;
 #endif
   MaxWinSize=0;
   MaxWinMask=0;
+  memset(&BlockTables,0,sizeof(BlockTables));
 
   // Perform initialization, which should be done only once for all files.
   // It prevents crash if first DoUnpack call is later made with wrong
   // (true) 'Solid' value.
   UnpInitData(false);
 #ifndef SFX_MODULE
-  // RAR 1.5 decompression initialization
+  // RAR 1.5 decompression initialization. Huffman tables are initialized
+  // when allocated.
   UnpInitData15(false);
-  InitHuff();
 #endif
 }
 
@@ -49,12 +57,13 @@ Unpack::~Unpack()
 {
   InitFilters30(false);
 
-  if (Window!=NULL)
-    free(Window);
+  delete T15;
+  delete T20;
+  delete PPM;
+  FreeWindow(Window,MaxWinSize);
 #ifdef RAR_SMP
   DestroyThreadPool(UnpThreadPool);
-  delete[] ReadBufMT;
-  delete[] UnpThreadData;
+  FreeMT();
 #endif
 }
 
@@ -91,7 +100,8 @@ void Unpack::Init(size_t WinSize,bool Solid)
   if (Grow && Fragmented)
     throw std::bad_alloc();
 
-  byte *NewWindow=Fragmented ? NULL : (byte *)malloc(WinSize);
+  // Cached window can be larger than requested, so WinSize can grow here.
+  byte *NewWindow=Fragmented ? NULL : AllocWindow(WinSize);
 
   if (NewWindow==NULL)
     if (Grow || WinSize<0x1000000)
@@ -104,7 +114,7 @@ void Unpack::Init(size_t WinSize,bool Solid)
     {
       if (Window!=NULL) // If allocated by preceding files.
       {
-        free(Window);
+        FreeWindow(Window,MaxWinSize);
         Window=NULL;
       }
       FragWindow.Init(WinSize);
@@ -125,8 +135,7 @@ void Unpack::Init(size_t WinSize,bool Solid)
       for (size_t I=1;I<=MaxWinSize;I++)
         NewWindow[(UnpPtr-I)&(WinSize-1)]=Window[(UnpPtr-I)&(MaxWinSize-1)];
 
-    if (Window!=NULL)
-      free(Window);
+    FreeWindow(Window,MaxWinSize);
     Window=NewWindow;
   }
 
@@ -159,7 +168,7 @@ void Unpack::DoUnpack(uint Method,bool Solid)
       break;
     case 50: // RAR 5.0 compression algorithm.
 #ifdef RAR_SMP
-      if (MaxUserThreads>1)
+      if (MaxUserThreads>1 && (Solid || DestUnpSize>=UNPACK_MIN_MT_SIZE))
       {
 //      We do not use the multithreaded unpack routine to repack RAR archives
 //      in 'suspended' mode, because unlike the single threaded code it can
@@ -187,7 +196,9 @@ void Unpack::UnpInitData(bool Solid)
     OldDistPtr=0;
     LastDist=LastLength=0;
 //    memset(Window,0,MaxWinSize);
-    memset(&BlockTables,0,sizeof(BlockTables));
+    // We do not clean BlockTables here. TablesRead flags are reset below,
+    // so tables are always built again before use in non-solid mode.
+    // It saves 19 KB memset per file for small files.
     UnpPtr=WrPtr=0;
     WriteBorder=Min(MaxWinSize,UNPACK_MAX_WRITE)&MaxWinMask;
   }
@@ -27,6 +27,11 @@
 // so we keep number of buffered filter in unpacker reasonable.
 #define UNPACK_MAX_WRITE      0x400000
 
+// Non-solid files smaller than this are unpacked in single thread mode.
+// They have too few blocks to benefit from threads, but would pay for
+// multithreaded buffers and task switching.
+#define UNPACK_MIN_MT_SIZE    0x100000
+
 // Decode compressed bit fields to alphabet numbers.
 struct DecodeTable:PackDef
 {
@@ -96,9 +101,10 @@ enum UNP_DEC_TYPE {
   UNPDT_LITERAL,UNPDT_MATCH,UNPDT_FULLREP,UNPDT_REP,UNPDT_FILTER
 };
 
+// Kept to 8 bytes, there can be tens of thousands of items per block.
 struct UnpackDecodedItem
 {
-  UNP_DEC_TYPE Type;
+  byte Type; // UNP_DEC_TYPE, enum would take 4 bytes here.
   ushort Length;
   union
   {
@@ -178,6 +184,32 @@ struct AudioVariables // For RAR 2.0 archives only.
 };
 
 
+// RAR 1.5 Huffman tables. Allocated only when unpacking RAR 1.5 data,
+// so Unpack objects used for newer formats do not carry them.
+struct UnpackTables15
+{
+  ushort ChSet[256],ChSetA[256],ChSetB[256],ChSetC[256];
+  byte NToPl[256],NToPlB[256],NToPlC[256];
+};
+
+
+// RAR 2.0 multimedia tables, allocated only when unpacking RAR 2.0 data.
+struct UnpackTables20
+{
+  DecodeTable MD[4]; // Decode multimedia data, up to 4 channels.
+  byte UnpOldTable20[PackDef::MC20*4];
+  AudioVariables AudV[4];
+};
+
+
+// Dictionary windows are cached between Unpack objects, see winpool.cpp.
+byte* AllocWindow(size_t &Size);
+void FreeWindow(byte *Mem,size_t Size);
+void SetWindowPoolLimit(size_t Limit);
+void TrimWindowPool();
+size_t GetWindowPoolSize();
+
+
 // We can use the fragmented dictionary in case heap does not have the single
 // large enough memory block. It is slower than normal dictionary.
 class FragmentedWindow
@@ -204,6 +236,7 @@ class Unpack:PackDef
   private:
 
     void Unpack5(bool Solid);
+    template <bool FragWin> void Unpack5Loop(bool Solid);
     void Unpack5MT(bool Solid);
     bool UnpReadBuf();
     void UnpWriteBuf();
@@ -230,14 +263,17 @@ class Unpack:PackDef
     BitInput Inp;
 
 #ifdef RAR_SMP
-    void InitMT();
+    void InitMT(int64 PackSize);
+    void FreeMT();
     bool UnpackLargeBlock(UnpackThreadData &D);
     bool ProcessDecoded(UnpackThreadData &D);
 
     ThreadPool *UnpThreadPool;
     UnpackThreadData *UnpThreadData;
+    uint UnpThreadDataCount;
     uint MaxUserThreads;
     byte *ReadBufMT;
+    size_t ReadBufMTSize;
 #endif
 
     Array<byte> FilterSrcMemory;
@@ -295,8 +331,7 @@ class Unpack:PackDef
     void CopyString15(uint Distance,uint Length);
     uint DecodeNum(uint Num,uint StartPos,uint *DecTab,uint *PosTab);
 
-    ushort ChSet[256],ChSetA[256],ChSetB[256],ChSetC[256];
-    byte NToPl[256],NToPlB[256],NToPlC[256];
+    UnpackTables15 *T15;
     uint FlagBuf,AvrPlc,AvrPlcB,AvrLn1,AvrLn2,AvrLn3;
     int Buf60,NumHuf,StMode,LCount,FlagsCnt;
     uint Nhfb,Nlzb,MaxDist3;
@@ -305,9 +340,8 @@ class Unpack:PackDef
 /***************************** Unpack v 2.0 *********************************/
     void Unpack20(bool Solid);
 
-    DecodeTable MD[4]; // Decode multimedia data, up to 4 channels.
+    UnpackTables20 *T20;
 
-    unsigned char UnpOldTable20[MC20*4];
     bool UnpAudioBlock;
     uint UnpChannels,UnpCurChannel;
     int UnpChannelDelta;
@@ -317,7 +351,6 @@ class Unpack:PackDef
     void UnpInitData20(int Solid);
     void ReadLastTables();
     byte DecodeAudio(int Delta);
-    struct AudioVariables AudV[4];
 /***************************** Unpack v 2.0 *********************************/
 
 /***************************** Unpack v 3.0 *********************************/
@@ -338,7 +371,8 @@ class Unpack:PackDef
 
     int PrevLowDist,LowDistRepCount;
 
-    ModelPPM PPM;
+    // Allocated on the first PPM block.
+    ModelPPM *PPM;
     int PPMEscChar;
 
     byte UnpOldTable[HUFF_TABLE_SIZE30];
@@ -356,6 +390,7 @@ class Unpack:PackDef
   
     // Buffer to read VM filters code. We moved it here from AddVMCode
     // function to reduce time spent in BitInput constructor.
+    // Its buffer is allocated on the first filter.
     BitInput VMCodeInp;
 
     // Filters code, one entry per filter.
@@ -39,6 +39,11 @@ static unsigned int PosHf4[]={0,0,0,0,0,0,0,0,0,255,0,0,0};
 
 void Unpack::Unpack15(bool Solid)
 {
+  if (T15==NULL)
+  {
+    T15=new UnpackTables15;
+    InitHuff();
+  }
   UnpInitData(Solid);
   UnpInitData15(Solid);
   UnpReadBuf();
@@ -210,12 +215,12 @@ void Unpack::ShortLZ()
   AvrLn1 -= AvrLn1 >> 4;
 
   DistancePlace=DecodeNum(Inp.fgetbits(),STARTHF2,DecHf2,PosHf2) & 0xff;
-  Distance=ChSetA[DistancePlace];
+  Distance=T15->ChSetA[DistancePlace];
   if (--DistancePlace != -1)
   {
-    LastDistance=ChSetA[DistancePlace];
-    ChSetA[DistancePlace+1]=LastDistance;
-    ChSetA[DistancePlace]=Distance;
+    LastDistance=T15->ChSetA[DistancePlace];
+    T15->ChSetA[DistancePlace+1]=LastDistance;
+    T15->ChSetA[DistancePlace]=Distance;
   }
   Length+=2;
   OldDist[OldDistPtr++] = ++Distance;
@@ -277,16 +282,16 @@ void Unpack::LongLZ()
   AvrPlcB -= AvrPlcB >> 8;
   while (1)
   {
-    Distance = ChSetB[DistancePlace & 0xff];
-    NewDistancePlace = NToPlB[Distance++ & 0xff]++;
+    Distance = T15->ChSetB[DistancePlace & 0xff];
+    NewDistancePlace = T15->NToPlB[Distance++ & 0xff]++;
     if (!(Distance & 0xff))
-      CorrHuff(ChSetB,NToPlB);
+      CorrHuff(T15->ChSetB,T15->NToPlB);
     else
       break;
   }
 
-  ChSetB[DistancePlace & 0xff]=ChSetB[NewDistancePlace];
-  ChSetB[NewDistancePlace]=Distance;
+  T15->ChSetB[DistancePlace & 0xff]=T15->ChSetB[NewDistancePlace];
+  T15->ChSetB[NewDistancePlace]=Distance;
 
   Distance=((Distance & 0xff00) | (Inp.fgetbits() >> 8)) >> 1;
   Inp.faddbits(7);
@@ -378,21 +383,21 @@ void Unpack::HuffDecode()
     Nlzb >>= 1;
   }
 
-  Window[UnpPtr++]=(byte)(ChSet[BytePlace]>>8);
+  Window[UnpPtr++]=(byte)(T15->ChSet[BytePlace]>>8);
   --DestUnpSize;
 
   while (1)
   {
-    CurByte=ChSet[BytePlace];
-    NewBytePlace=NToPl[CurByte++ & 0xff]++;
+    CurByte=T15->ChSet[BytePlace];
+    NewBytePlace=T15->NToPl[CurByte++ & 0xff]++;
     if ((CurByte & 0xff) > 0xa1)
-      CorrHuff(ChSet,NToPl);
+      CorrHuff(T15->ChSet,T15->NToPl);
     else
       break;
   }
 
-  ChSet[BytePlace]=ChSet[NewBytePlace];
-  ChSet[NewBytePlace]=CurByte;
+  T15->ChSet[BytePlace]=T15->ChSet[NewBytePlace];
+  T15->ChSet[NewBytePlace]=CurByte;
 }
 
 
@@ -406,21 +411,21 @@ void Unpack::GetFlagsBuf()
   // While normally we do not use the last item to code the flags byte here,
   // we need to check for value 256 when unpacking in case we unpack
   // a corrupt archive.
-  if (FlagsPlace>=sizeof(ChSetC)/sizeof(ChSetC[0]))
+  if (FlagsPlace>=sizeof(T15->ChSetC)/sizeof(T15->ChSetC[0]))
     return;
 
   while (1)
   {
-    Flags=ChSetC[FlagsPlace];
+    Flags=T15->ChSetC[FlagsPlace];
     FlagBuf=Flags>>8;
-    NewFlagsPlace=NToPlC[Flags++ & 0xff]++;
+    NewFlagsPlace=T15->NToPlC[Flags++ & 0xff]++;
     if ((Flags & 0xff) != 0)
       break;
-    CorrHuff(ChSetC,NToPlC);
+    CorrHuff(T15->ChSetC,T15->NToPlC);
   }
 
-  ChSetC[FlagsPlace]=ChSetC[NewFlagsPlace];
-  ChSetC[NewFlagsPlace]=Flags;
+  T15->ChSetC[FlagsPlace]=T15->ChSetC[NewFlagsPlace];
+  T15->ChSetC[NewFlagsPlace]=Flags;
 }
 
 
@@ -445,14 +450,14 @@ void Unpack::InitHuff()
 {
   for (unsigned int I=0;I<256;I++)
   {
-    ChSet[I]=ChSetB[I]=I<<8;
-    ChSetA[I]=I;
-    ChSetC[I]=((~I+1) & 0xff)<<8;
+    T15->ChSet[I]=T15->ChSetB[I]=I<<8;
+    T15->ChSetA[I]=I;
+    T15->ChSetC[I]=((~I+1) & 0xff)<<8;
   }
-  memset(NToPl,0,sizeof(NToPl));
-  memset(NToPlB,0,sizeof(NToPlB));
-  memset(NToPlC,0,sizeof(NToPlC));
-  CorrHuff(ChSetB,NToPlB);
+  memset(T15->NToPl,0,sizeof(T15->NToPl));
+  memset(T15->NToPlB,0,sizeof(T15->NToPlB));
+  memset(T15->NToPlC,0,sizeof(T15->NToPlC));
+  CorrHuff(T15->ChSetB,T15->NToPlB);
 }
 
 
@@ -462,7 +467,7 @@ void Unpack::CorrHuff(ushort *CharSet,byte *NumToPlace)
   for (I=7;I>=0;I--)
     for (J=0;J<32;J++,CharSet++)
       *CharSet=(*CharSet & ~0xff) | I;
-  memset(NumToPlace,0,sizeof(NToPl));
+  memset(NumToPlace,0,sizeof(T15->NToPl));
   for (I=6;I>=0;I--)
     NumToPlace[I]=(7-I)*32;
 }
@@ -20,6 +20,12 @@ void Unpack::Unpack20(bool Solid)
   static unsigned char SDBits[]=  {2,2,3, 4, 5, 6,  6,  6};
   uint Bits;
 
+  if (T20==NULL)
+  {
+    T20=new UnpackTables20;
+    memset(T20,0,sizeof(*T20));
+  }
+
   if (Suspended)
     UnpPtr=WrPtr;
   else
@@ -47,7 +53,7 @@ void Unpack::Unpack20(bool Solid)
     }
     if (UnpAudioBlock)
     {
-      uint AudioNumber=DecodeNumber(Inp,&MD[UnpCurChannel]);
+      uint AudioNumber=DecodeNumber(Inp,&T20->MD[UnpCurChannel]);
 
       if (AudioNumber==256)
       {
@@ -174,7 +180,7 @@ bool Unpack::ReadTables20()
   UnpAudioBlock=(BitField & 0x8000)!=0;
 
   if (!(BitField & 0x4000))
-    memset(UnpOldTable20,0,sizeof(UnpOldTable20));
+    memset(T20->UnpOldTable20,0,sizeof(T20->UnpOldTable20));
   Inp.addbits(2);
 
   uint TableSize;
@@ -203,7 +209,7 @@ bool Unpack::ReadTables20()
     uint Number=DecodeNumber(Inp,&BlockTables.BD);
     if (Number<16)
     {
-      Table[I]=(Number+UnpOldTable20[I]) & 0xf;
+      Table[I]=(Number+T20->UnpOldTable20[I]) & 0xf;
       I++;
     }
     else
@@ -242,14 +248,14 @@ bool Unpack::ReadTables20()
     return true;
   if (UnpAudioBlock)
     for (uint I=0;I<UnpChannels;I++)
-      MakeDecodeTables(&Table[I*MC20],&MD[I],MC20);
+      MakeDecodeTables(&Table[I*MC20],&T20->MD[I],MC20);
   else
   {
     MakeDecodeTables(&Table[0],&BlockTables.LD,NC20);
     MakeDecodeTables(&Table[NC20],&BlockTables.DD,DC20);
     MakeDecodeTables(&Table[NC20+DC20],&BlockTables.RD,RC20);
   }
-  memcpy(UnpOldTable20,Table,TableSize);
+  memcpy(T20->UnpOldTable20,Table,TableSize);
   return true;
 }
 
@@ -259,7 +265,7 @@ void Unpack::ReadLastTables()
   if (ReadTop>=Inp.InAddr+5)
     if (UnpAudioBlock)
     {
-      if (DecodeNumber(Inp,&MD[UnpCurChannel])==256)
+      if (DecodeNumber(Inp,&T20->MD[UnpCurChannel])==256)
         ReadTables20();
     }
     else
@@ -278,16 +284,19 @@ void Unpack::UnpInitData20(int Solid)
     UnpCurChannel=0;
     UnpChannels=1;
 
-    memset(AudV,0,sizeof(AudV));
-    memset(UnpOldTable20,0,sizeof(UnpOldTable20));
-    memset(MD,0,sizeof(MD));
+    if (T20!=NULL)
+    {
+      memset(T20->AudV,0,sizeof(T20->AudV));
+      memset(T20->UnpOldTable20,0,sizeof(T20->UnpOldTable20));
+      memset(T20->MD,0,sizeof(T20->MD));
+    }
   }
 }
 
 
 byte Unpack::DecodeAudio(int Delta)
 {
-  struct AudioVariables *V=&AudV[UnpCurChannel];
+  struct AudioVariables *V=&T20->AudV[UnpCurChannel];
   V->ByteCount++;
   V->D4=V->D3;
   V->D3=V->D2;
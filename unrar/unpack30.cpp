@@ -1,12 +1,12 @@
-// We use it instead of direct PPM.DecodeChar call to be sure that
+// We use it instead of direct PPM->DecodeChar call to be sure that
 // we reset PPM structures in case of corrupt data. It is important,
-// because these structures can be invalid after PPM.DecodeChar returned -1.
+// because these structures can be invalid after PPM->DecodeChar returned -1.
 inline int Unpack::SafePPMDecodeChar()
 {
-  int Ch=PPM.DecodeChar();
+  int Ch=PPM->DecodeChar();
   if (Ch==-1)              // Corrupt PPM data found.
   {
-    PPM.CleanUp();         // Reset possibly corrupt PPM data structures.
+    PPM->CleanUp();         // Reset possibly corrupt PPM data structures.
     UnpBlockType=BLOCK_LZ; // Set faster and more fail proof LZ mode.
   }
   return(Ch);
@@ -71,10 +71,10 @@ void Unpack::Unpack29(bool Solid)
       // Here speed is critical, so we do not use SafePPMDecodeChar,
       // because sometimes even the inline function can introduce
       // some additional penalty.
-      int Ch=PPM.DecodeChar();
+      int Ch=PPM->DecodeChar();
       if (Ch==-1)              // Corrupt PPM data found.
       {
-        PPM.CleanUp();         // Reset possibly corrupt PPM data structures.
+        PPM->CleanUp();         // Reset possibly corrupt PPM data structures.
         UnpBlockType=BLOCK_LZ; // Set faster and more fail proof LZ mode.
         break;
       }
@@ -97,7 +97,7 @@ void Unpack::Unpack29(bool Solid)
             break;
           continue;
         }
-        if (NextCh==4) // LZ inside of PPM.
+        if (NextCh==4) // LZ inside of PPM->
         {
           unsigned int Distance=0,Length;
           bool Failed=false;
@@ -118,7 +118,7 @@ void Unpack::Unpack29(bool Solid)
           CopyString(Length+32,Distance+2);
           continue;
         }
-        if (NextCh==5) // One byte distance match (RLE) inside of PPM.
+        if (NextCh==5) // One byte distance match (RLE) inside of PPM->
         {
           int Length=SafePPMDecodeChar();
           if (Length==-1)
@@ -360,6 +360,12 @@ bool Unpack::ReadVMCodePPM()
 
 bool Unpack::AddVMCode(uint FirstByte,byte *Code,uint CodeSize)
 {
+  if (VMCodeInp.InBuf==NULL) // Allocate on the first filter only.
+  {
+    // 3 extra bytes for getbits32, same as in BitInput constructor.
+    VMCodeInp.InBuf=new byte[BitInput::MAX_SIZE+3];
+    memset(VMCodeInp.InBuf,0,BitInput::MAX_SIZE+3);
+  }
   VMCodeInp.InitBitInput();
   memcpy(VMCodeInp.InBuf,Code,Min(BitInput::MAX_SIZE,CodeSize));
   VM.Init();
@@ -637,7 +643,9 @@ bool Unpack::ReadTables30()
   if (BitField & 0x8000)
   {
     UnpBlockType=BLOCK_PPM;
-    return(PPM.DecodeInit(this,PPMEscChar));
+    if (PPM==NULL)
+      PPM=new ModelPPM;
+    return(PPM->DecodeInit(this,PPMEscChar));
   }
   UnpBlockType=BLOCK_LZ;
   
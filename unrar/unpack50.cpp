@@ -1,4 +1,7 @@
-void Unpack::Unpack5(bool Solid)
+// Decode loop specialized for contiguous (FragWin is false) or fragmented
+// window, so the common contiguous case does not check the window type
+// for every literal and match.
+template <bool FragWin> void Unpack::Unpack5Loop(bool Solid)
 {
   FileExtracted=true;
 
@@ -57,7 +60,7 @@ void Unpack::Unpack5(bool Solid)
     uint MainSlot=DecodeNumber(Inp,&BlockTables.LD);
     if (MainSlot<256)
     {
-      if (Fragmented)
+      if (FragWin)
         FragWindow[UnpPtr++]=(byte)MainSlot;
       else
         Window[UnpPtr++]=(byte)MainSlot;
@@ -111,7 +114,7 @@ void Unpack::Unpack5(bool Solid)
 
       InsertOldDist(Distance);
       LastLength=Length;
-      if (Fragmented)
+      if (FragWin)
         FragWindow.CopyString(Length,Distance,UnpPtr,MaxWinMask);
       else
         CopyString(Length,Distance);
@@ -127,7 +130,7 @@ void Unpack::Unpack5(bool Solid)
     if (MainSlot==257)
     {
       if (LastLength!=0)
-        if (Fragmented)
+        if (FragWin)
           FragWindow.CopyString(LastLength,OldDist[0],UnpPtr,MaxWinMask);
         else
           CopyString(LastLength,OldDist[0]);
@@ -144,7 +147,7 @@ void Unpack::Unpack5(bool Solid)
       uint LengthSlot=DecodeNumber(Inp,&BlockTables.RD);
       uint Length=SlotToLength(Inp,LengthSlot);
       LastLength=Length;
-      if (Fragmented)
+      if (FragWin)
         FragWindow.CopyString(Length,Distance,UnpPtr,MaxWinMask);
       else
         CopyString(Length,Distance);
@@ -155,6 +158,16 @@ void Unpack::Unpack5(bool Solid)
 }
 
 
+void Unpack::Unpack5(bool Solid)
+{
+  // Select the window type once per file.
+  if (Fragmented)
+    Unpack5Loop<true>(Solid);
+  else
+    Unpack5Loop<false>(Solid);
+}
+
+
 uint Unpack::ReadFilterData(BitInput &Inp)
 {
   uint ByteCount=(Inp.fgetbits()>>14)+1;
@@ -395,6 +408,74 @@ void Unpack::UnpWriteBuf()
 }
 
 
+// Return the position of first 0xe8 or CmpByte2 byte or Size if not found.
+static uint FindE8(const byte *Data,uint Size,byte CmpByte2)
+{
+  for (uint I=0;I<Size;I++)
+    if (Data[I]==0xe8 || Data[I]==CmpByte2)
+      return I;
+  return Size;
+}
+
+
+#ifdef USE_SSE
+static uint FindE8_SSE2(const byte *Data,uint Size,byte CmpByte2)
+{
+  const __m128i E8=_mm_set1_epi8((char)0xe8),Cmp2=_mm_set1_epi8((char)CmpByte2);
+  uint Pos=0;
+  for (;Pos+16<=Size;Pos+=16)
+  {
+    __m128i D=_mm_loadu_si128((const __m128i *)(Data+Pos));
+    uint Mask=_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(D,E8),_mm_cmpeq_epi8(D,Cmp2)));
+    if (Mask!=0)
+      for (uint I=0;;I++)
+        if ((Mask & (1<<I))!=0)
+          return Pos+I;
+  }
+  return Pos+FindE8(Data+Pos,Size-Pos,CmpByte2);
+}
+
+
+SSE_TARGET("avx2") static uint FindE8_AVX2(const byte *Data,uint Size,byte CmpByte2)
+{
+  const __m256i E8=_mm256_set1_epi8((char)0xe8),Cmp2=_mm256_set1_epi8((char)CmpByte2);
+  uint Pos=0;
+  for (;Pos+32<=Size;Pos+=32)
+  {
+    __m256i D=_mm256_loadu_si256((const __m256i *)(Data+Pos));
+    uint Mask=_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(D,E8),_mm256_cmpeq_epi8(D,Cmp2)));
+    if (Mask!=0)
+      for (uint I=0;;I++)
+        if ((Mask & (1U<<I))!=0)
+          return Pos+I;
+  }
+  return Pos+FindE8(Data+Pos,Size-Pos,CmpByte2);
+}
+#endif
+
+
+static uint FindE8_Select(const byte *Data,uint Size,byte CmpByte2);
+
+// Set to the best E8 search function for current CPU on first call.
+// Decoder threads can call it first at the same time.
+static std::atomic<uint (*)(const byte *Data,uint Size,byte CmpByte2)> FindE8_Proc(FindE8_Select);
+
+uint FindE8_Select(const byte *Data,uint Size,byte CmpByte2)
+{
+  uint (*Proc)(const byte *Data,uint Size,byte CmpByte2)=FindE8;
+#ifdef USE_SSE
+  uint Features=GetCPUFeatures();
+  if ((Features & CPU_AVX2)!=0)
+    Proc=FindE8_AVX2;
+  else
+    if ((Features & CPU_SSE2)!=0)
+      Proc=FindE8_SSE2;
+#endif
+  FindE8_Proc.store(Proc,std::memory_order_relaxed);
+  return Proc(Data,Size,CmpByte2);
+}
+
+
 byte* Unpack::ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt)
 {
   byte *SrcData=Data;
@@ -407,31 +488,32 @@ byte* Unpack::ApplyFilter(byte *Data,uint DataSize,UnpackFilter *Flt)
 
         const uint FileSize=0x1000000;
         byte CmpByte2=Flt->Type==FILTER_E8E9 ? 0xe9:0xe8;
-        // DataSize is unsigned, so we use "CurPos+4" and not "DataSize-4"
+        // Only bytes followed by 4 byte address can be processed.
+        // DataSize is unsigned, so we check it before subtracting
         // to avoid overflow for DataSize<4.
-        for (uint CurPos=0;CurPos+4<DataSize;)
+        uint ScanSize=DataSize>4 ? DataSize-4:0;
+        for (uint CurPos=0;CurPos<ScanSize;)
         {
-          byte CurByte=*(Data++);
+          CurPos+=FindE8_Proc.load(std::memory_order_relaxed)(Data+CurPos,ScanSize-CurPos,CmpByte2);
+          if (CurPos>=ScanSize)
+            break;
           CurPos++;
-          if (CurByte==0xe8 || CurByte==CmpByte2)
-          {
-            uint Offset=(CurPos+FileOffset)%FileSize;
-            uint Addr=RawGet4(Data);
-
-            // We check 0x80000000 bit instead of '< 0' comparison
-            // not assuming int32 presence or uint size and endianness.
-            if ((Addr & 0x80000000)!=0)              // Addr<0
-            {
-              if (((Addr+Offset) & 0x80000000)==0)   // Addr+Offset>=0
-                RawPut4(Addr+FileSize,Data);
-            }
-            else
-              if (((Addr-FileSize) & 0x80000000)!=0) // Addr<FileSize
-                RawPut4(Addr-Offset,Data);
+          byte *D=Data+CurPos;
+          uint Offset=(CurPos+FileOffset)%FileSize;
+          uint Addr=RawGet4(D);
 
-            Data+=4;
-            CurPos+=4;
+          // We check 0x80000000 bit instead of '< 0' comparison
+          // not assuming int32 presence or uint size and endianness.
+          if ((Addr & 0x80000000)!=0)              // Addr<0
+          {
+            if (((Addr+Offset) & 0x80000000)==0)   // Addr+Offset>=0
+              RawPut4(Addr+FileSize,D);
           }
+          else
+            if (((Addr-FileSize) & 0x80000000)!=0) // Addr<FileSize
+              RawPut4(Addr-Offset,D);
+
+          CurPos+=4;
         }
       }
       return SrcData;
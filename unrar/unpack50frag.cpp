@@ -16,7 +16,7 @@ void FragmentedWindow::Reset()
   for (uint I=0;I<ASIZE(Mem);I++)
     if (Mem[I]!=NULL)
     {
-      free(Mem[I]);
+      LargeFree(Mem[I],MemSize[I]-(I>0 ? MemSize[I-1]:0));
       Mem[I]=NULL;
     }
 }
@@ -41,7 +41,7 @@ void FragmentedWindow::Init(size_t WinSize)
     byte *NewMem=NULL;
     while (Size>=MinSize)
     {
-      NewMem=(byte *)malloc(Size);
+      NewMem=(byte *)LargeAlloc(Size);
       if (NewMem!=NULL)
         break;
       Size-=Size/32;
@@ -76,21 +76,40 @@ byte& FragmentedWindow::operator [](size_t Item)
 
 void FragmentedWindow::CopyString(uint Length,uint Distance,size_t &UnpPtr,size_t MaxWinMask)
 {
-  size_t SrcPtr=UnpPtr-Distance;
-  while (Length-- > 0)
+  size_t SrcPtr=(UnpPtr-Distance) & MaxWinMask;
+  while (Length>0)
   {
-    (*this)[UnpPtr]=(*this)[SrcPtr++ & MaxWinMask];
-    // We need to have masked UnpPtr after quit from loop, so it must not
-    // be replaced with '(*this)[UnpPtr++ & MaxWinMask]'
-    UnpPtr=(UnpPtr+1) & MaxWinMask;
+    // Copy the longest run, which is contiguous both in source and
+    // destination. The last block ends at the window size, so window
+    // wrap is also a block border. If source and destination overlap,
+    // they are in the same block and the forward byte copy below repeats
+    // the string as required.
+    size_t Run=Min(GetBlockSize(SrcPtr,Length),GetBlockSize(UnpPtr,Length));
+    if (Run==0) // Must never happen.
+      break;
+    byte *Src=&(*this)[SrcPtr],*Dest=&(*this)[UnpPtr];
+    for (size_t I=0;I<Run;I++)
+      Dest[I]=Src[I];
+    Length-=(uint)Run;
+    SrcPtr=(SrcPtr+Run) & MaxWinMask;
+    // We need to have masked UnpPtr after quit from loop.
+    UnpPtr=(UnpPtr+Run) & MaxWinMask;
   }
 }
 
 
 void FragmentedWindow::CopyData(byte *Dest,size_t WinPos,size_t Size)
 {
-  for (size_t I=0;I<Size;I++)
-    Dest[I]=(*this)[WinPos+I];
+  while (Size>0)
+  {
+    size_t BlockSize=GetBlockSize(WinPos,Size);
+    if (BlockSize==0) // Must never happen.
+      break;
+    memcpy(Dest,&(*this)[WinPos],BlockSize);
+    Dest+=BlockSize;
+    WinPos+=BlockSize;
+    Size-=BlockSize;
+  }
 }
 
 
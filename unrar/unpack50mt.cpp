@@ -1,6 +1,20 @@
 #define UNP_READ_SIZE_MT        0x400000
+
+// Minimum read buffer size. Smaller files are read entirely in one pass.
+#define UNP_READ_MIN_MT          0x20000
+
+// Even getbits32 can read up to 3 additional bytes after current
+// and our block header and table reading code can look much further.
+// Let's allocate the additional space after ReadBufMT, so we do not need
+// to check bounds for every bit field access.
+#define UNP_READ_OVERFLOW_MT        1024
 #define UNP_BLOCKS_PER_THREAD          2
 
+// Low estimate of compressed block size used to find how many blocks
+// a file can contain, so we do not allocate thread data for blocks
+// which cannot be present in small files.
+#define UNP_BLOCK_SIZE_MT_EST       0x8000
+
 
 struct UnpackThreadDataList
 {
@@ -17,48 +31,67 @@ THREAD_PROC(UnpackDecodeThread)
 }
 
 
-void Unpack::InitMT()
+// Allocate read buffer and thread data sized for PackSize bytes of input.
+// Buffers are only grown here, so they fit the largest file of solid stream.
+void Unpack::InitMT(int64 PackSize)
 {
+  size_t ReadSize=UNP_READ_SIZE_MT;
+  if (PackSize>=0 && PackSize<UNP_READ_SIZE_MT)
+    ReadSize=Max(((size_t)PackSize+0xfff)&~0xfff,(size_t)UNP_READ_MIN_MT);
+  if (ReadBufMT!=NULL && ReadBufMTSize<ReadSize)
+  {
+    LargeFree(ReadBufMT,ReadBufMTSize+UNP_READ_OVERFLOW_MT);
+    ReadBufMT=NULL;
+  }
   if (ReadBufMT==NULL)
   {
-    // Even getbits32 can read up to 3 additional bytes after current
-    // and our block header and table reading code can look much further.
-    // Let's allocate the additional space here, so we do not need to check
-    // bounds for every bit field access.
-    const size_t Overflow=1024;
-
-    ReadBufMT=new byte[UNP_READ_SIZE_MT+Overflow];
-    memset(ReadBufMT,0,UNP_READ_SIZE_MT+Overflow);
+    ReadBufMT=(byte *)LargeAlloc(ReadSize+UNP_READ_OVERFLOW_MT);
+    if (ReadBufMT==NULL)
+      throw std::bad_alloc();
+    memset(ReadBufMT,0,ReadSize+UNP_READ_OVERFLOW_MT);
+    ReadBufMTSize=ReadSize;
+  }
+
+  uint MaxItems=MaxUserThreads*UNP_BLOCKS_PER_THREAD;
+  if (ReadBufMTSize/UNP_BLOCK_SIZE_MT_EST+1<MaxItems)
+    MaxItems=uint(ReadBufMTSize/UNP_BLOCK_SIZE_MT_EST+1);
+  if (UnpThreadData!=NULL && UnpThreadDataCount<MaxItems)
+  {
+    delete[] UnpThreadData;
+    UnpThreadData=NULL;
   }
   if (UnpThreadData==NULL)
   {
-    uint MaxItems=MaxUserThreads*UNP_BLOCKS_PER_THREAD;
     UnpThreadData=new UnpackThreadData[MaxItems];
     memset(UnpThreadData,0,sizeof(UnpackThreadData)*MaxItems);
-
-    for (uint I=0;I<MaxItems;I++)
-    {
-      UnpackThreadData *CurData=UnpThreadData+I;
-      if (CurData->Decoded==NULL)
-      {
-        // Typical number of items in RAR blocks does not exceed 0x4000.
-        CurData->DecodedAllocated=0x4100;
-        // It will be freed in the object destructor, not in this file.
-        CurData->Decoded=(UnpackDecodedItem *)malloc(CurData->DecodedAllocated*sizeof(UnpackDecodedItem));
-        if (CurData->Decoded==NULL)
-          ErrHandler.MemoryError();
-      }
-    }
+    // Decoded item buffers are allocated in UnpackDecode, when we know
+    // the block size.
+    UnpThreadDataCount=MaxItems;
   }
 }
 
 
+// Release multithreading buffers. They are allocated again when needed.
+void Unpack::FreeMT()
+{
+  if (ReadBufMT!=NULL)
+    LargeFree(ReadBufMT,ReadBufMTSize+UNP_READ_OVERFLOW_MT);
+  ReadBufMT=NULL;
+  ReadBufMTSize=0;
+  delete[] UnpThreadData;
+  UnpThreadData=NULL;
+  UnpThreadDataCount=0;
+}
+
+
 void Unpack::Unpack5MT(bool Solid)
 {
-  InitMT();
+  // Split file is read from all its parts, so its first part can be
+  // much smaller than blocks in next parts.
+  InitMT(UnpIO->GetTotalPackedSizeToRead());
   UnpInitData(Solid);
 
-  for (uint I=0;I<MaxUserThreads*UNP_BLOCKS_PER_THREAD;I++)
+  for (uint I=0;I<UnpThreadDataCount;I++)
   {
     UnpackThreadData *CurData=UnpThreadData+I;
     CurData->LargeBlock=false;
@@ -85,7 +118,7 @@ void Unpack::Unpack5MT(bool Solid)
     // so we can safely read them without additional checks.
     const int TooSmallToProcess=1024;
 
-    int ReadSize=UnpIO->UnpRead(ReadBufMT+DataSize,(UNP_READ_SIZE_MT-DataSize)&~0xf);
+    int ReadSize=UnpIO->UnpRead(ReadBufMT+DataSize,(int(ReadBufMTSize)-DataSize)&~0xf);
     if (ReadSize<0)
       break;
     DataSize+=ReadSize;
@@ -100,7 +133,7 @@ void Unpack::Unpack5MT(bool Solid)
     while (BlockStart<DataSize && !Done)
     {
       uint BlockNumber=0,BlockNumberMT=0;
-      while (BlockNumber<MaxUserThreads*UNP_BLOCKS_PER_THREAD)
+      while (BlockNumber<UnpThreadDataCount)
       {
         UnpackThreadData *CurData=UnpThreadData+BlockNumber;
         LastBlockNum=BlockNumber;
@@ -184,8 +217,6 @@ void Unpack::Unpack5MT(bool Solid)
 #ifdef USE_THREADS
         if (BlockNumber==1)
           UnpackDecode(*UTD->D);
-        else
-          UnpThreadPool->AddTask(UnpackDecodeThread,(void*)UTD);
 #else
         for (uint I=0;I<UTD->BlockCount;I++)
           UnpackDecode(UTD->D[I]);
@@ -196,6 +227,9 @@ void Unpack::Unpack5MT(bool Solid)
         break;
 
 #ifdef USE_THREADS
+      // Queue all prepared tasks at once to wake workers only once.
+      if (BlockNumber!=1)
+        UnpThreadPool->AddTasks(UnpackDecodeThread,UTDArray,sizeof(*UTDArray),UTDArrayPos);
       UnpThreadPool->WaitDone();
 #endif
 
@@ -282,6 +316,11 @@ void Unpack::Unpack5MT(bool Solid)
 
   BlockHeader=UnpThreadData[LastBlockNum].BlockHeader;
   BlockTables=UnpThreadData[LastBlockNum].BlockTables;
+
+  // Files of solid stream are decoded one after another, so keep buffers
+  // for them. Otherwise do not hold megabytes of memory in idle decoder.
+  if (!Solid)
+    FreeMT();
 }
 
 
@@ -304,6 +343,19 @@ void Unpack::UnpackDecode(UnpackThreadData &D)
     return;
   }
   
+  // Every item takes at least one bit of input, so this number of items
+  // is never exceeded in valid data.
+  uint MaxItems=(D.BlockHeader.BlockSize+D.BlockHeader.HeaderSize)*8+0x100;
+  if (D.Decoded==NULL)
+  {
+    // Typical number of items does not exceed a quarter of block size.
+    D.DecodedAllocated=Min((uint)D.BlockHeader.BlockSize/4+0x100,MaxItems);
+    // It will be freed in the object destructor, not in this file.
+    D.Decoded=(UnpackDecodedItem *)malloc(D.DecodedAllocated*sizeof(UnpackDecodedItem));
+    if (D.Decoded==NULL)
+      ErrHandler.MemoryError();
+  }
+
   D.DecodedSize=0;
   int BlockBorder=D.BlockHeader.BlockStart+D.BlockHeader.BlockSize-1;
 
@@ -330,6 +382,11 @@ void Unpack::UnpackDecode(UnpackThreadData &D)
     }
     if (D.DecodedSize>D.DecodedAllocated-8) // Filter can use several slots.
     {
+      if (D.DecodedAllocated>MaxItems) // Broken data, prevent unlimited growth.
+      {
+        D.DamagedData=true;
+        break;
+      }
       D.DecodedAllocated=D.DecodedAllocated*2;
       void *Decoded=realloc(D.Decoded,D.DecodedAllocated*sizeof(UnpackDecodedItem));
       if (Decoded==NULL)
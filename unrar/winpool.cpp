@@ -0,0 +1,156 @@
+// Process-wide cache of released dictionary windows. Reopening archives and
+// switching between Unpack objects reuses already allocated and touched
+// memory instead of requesting and page faulting the new one every time.
+static struct WindowPool
+{
+  // Not many windows are worth keeping, they can be hundreds of MB each.
+  static const uint MaxItems=16;
+
+  struct Item
+  {
+    byte *Mem;
+    size_t Size;
+  } Items[MaxItems]; // The least recently released window first.
+  uint ItemCount;
+
+  size_t Total; // Size of all cached windows.
+  size_t Limit; // Maximum size of all cached windows.
+#ifdef RAR_SMP
+  CRITSECT_HANDLE CritSection;
+#endif
+
+  WindowPool()
+  {
+    ItemCount=0;
+    Total=0;
+    Limit=sizeof(size_t)>4 ? 0x10000000 : 0x4000000;
+#ifdef RAR_SMP
+    CriticalSectionCreate(&CritSection);
+#endif
+  }
+  ~WindowPool()
+  {
+    Trim(0);
+#ifdef RAR_SMP
+    CriticalSectionDelete(&CritSection);
+#endif
+  }
+  void Lock()
+  {
+#ifdef RAR_SMP
+    CriticalSectionStart(&CritSection);
+#endif
+  }
+  void Unlock()
+  {
+#ifdef RAR_SMP
+    CriticalSectionEnd(&CritSection);
+#endif
+  }
+  void Remove(uint Pos)
+  {
+    Total-=Items[Pos].Size;
+    for (uint I=Pos+1;I<ItemCount;I++)
+      Items[I-1]=Items[I];
+    ItemCount--;
+  }
+  // Free the least recently released windows until cached size is not
+  // above MaxSize. Must be called inside of Lock/Unlock.
+  void Trim(size_t MaxSize)
+  {
+    while (ItemCount>0 && Total>MaxSize)
+    {
+      LargeFree(Items[0].Mem,Items[0].Size);
+      Remove(0);
+    }
+  }
+} WinPool;
+
+
+// Return the window of at least Size bytes. Size can be increased up to 4x
+// if a larger cached window is available, using it is cheaper than
+// allocating and faulting the new memory. Windows are powers of 2,
+// so the returned size is also suitable for window mask.
+byte* AllocWindow(size_t &Size)
+{
+  WinPool.Lock();
+  uint Found=WinPool.ItemCount;
+  for (uint I=0;I<WinPool.ItemCount;I++)
+  {
+    size_t ItemSize=WinPool.Items[I].Size;
+    // Prefer the smallest fitting and then the most recently released.
+    if (ItemSize>=Size && ItemSize/4<=Size &&
+        (Found==WinPool.ItemCount || ItemSize<=WinPool.Items[Found].Size))
+      Found=I;
+  }
+  if (Found<WinPool.ItemCount)
+  {
+    byte *Mem=WinPool.Items[Found].Mem;
+    Size=WinPool.Items[Found].Size;
+    WinPool.Remove(Found);
+    WinPool.Unlock();
+    return Mem;
+  }
+  WinPool.Unlock();
+
+  byte *Mem=(byte *)LargeAlloc(Size);
+  if (Mem==NULL)
+  {
+    // Release cached windows on low memory and try again.
+    TrimWindowPool();
+    Mem=(byte *)LargeAlloc(Size);
+  }
+  return Mem;
+}
+
+
+void FreeWindow(byte *Mem,size_t Size)
+{
+  if (Mem==NULL)
+    return;
+  WinPool.Lock();
+  if (Size>WinPool.Limit)
+  {
+    WinPool.Unlock();
+    LargeFree(Mem,Size);
+    return;
+  }
+  if (WinPool.ItemCount==WinPool.MaxItems)
+  {
+    LargeFree(WinPool.Items[0].Mem,WinPool.Items[0].Size);
+    WinPool.Remove(0);
+  }
+  WinPool.Trim(WinPool.Limit-Size);
+  WinPool.Items[WinPool.ItemCount].Mem=Mem;
+  WinPool.Items[WinPool.ItemCount].Size=Size;
+  WinPool.ItemCount++;
+  WinPool.Total+=Size;
+  WinPool.Unlock();
+}
+
+
+void SetWindowPoolLimit(size_t Limit)
+{
+  WinPool.Lock();
+  WinPool.Limit=Limit;
+  WinPool.Trim(Limit);
+  WinPool.Unlock();
+}
+
+
+void TrimWindowPool()
+{
+  WinPool.Lock();
+  WinPool.Trim(0);
+  WinPool.Unlock();
+}
+
+
+// Total size of currently cached windows.
+size_t GetWindowPoolSize()
+{
+  WinPool.Lock();
+  size_t Total=WinPool.Total;
+  WinPool.Unlock();
+  return Total;
+}